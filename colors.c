@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "colors.h"
+
+/*
+    LS_COLORS is a list of key=value pairs separated by ':'. Two letter keys color file types
+    (di, ln, ex, ...). Keys starting with '*' color files by the end of their name, like *.tar.gz.
+    Values are SGR codes like 01;34, and may use \ escapes and ^X caret notation.
+
+    Suffix rules are stored in a trie over the reversed suffixes, so finding the color of a name
+    is a walk backwards from the end of the name that stops as soon as no rule can match.
+    That is one step per byte of the matched suffix, no matter how many rules there are.
+*/
+
+//indicators we know about, same keys that GNU dircolors uses
+enum indicator {
+    IND_LC, IND_RC, IND_EC, IND_RS, IND_NO, IND_FI, IND_DI, IND_LN, IND_PI, IND_SO, IND_BD, IND_CD,
+    IND_MI, IND_OR, IND_EX, IND_DO, IND_SU, IND_SG, IND_ST, IND_OW, IND_TW, IND_CA, IND_MH, IND_CL,
+    IND_COUNT
+};
+
+static const char* const indicatorNames[IND_COUNT] = {
+    "lc", "rc", "ec", "rs", "no", "fi", "di", "ln", "pi", "so", "bd", "cd",
+    "mi", "or", "ex", "do", "su", "sg", "st", "ow", "tw", "ca", "mh", "cl"
+};
+
+//used when LS_COLORS is not set
+static const char* const defaultIndicators[IND_COUNT] = {
+    [IND_LC] = "\x1b[", [IND_RC] = "m", [IND_RS] = "0",
+    [IND_DI] = "01;34", [IND_LN] = "01;36", [IND_PI] = "33", [IND_SO] = "01;35",
+    [IND_BD] = "01;33", [IND_CD] = "01;33", [IND_EX] = "01;32", [IND_DO] = "01;35",
+    [IND_SU] = "37;41", [IND_SG] = "30;43", [IND_ST] = "37;44", [IND_OW] = "34;42",
+    [IND_TW] = "30;42",
+};
+
+static const char* indicators[IND_COUNT];
+static bool enabled = false;
+static bool linkAsTarget = false;   //ln=target, color links like the file they point to
+
+//one edge of the suffix trie. Edges live in one open addressing hash table keyed on (parent, byte)
+typedef struct trieEdge {
+    int parent;     //-1 marks an empty slot
+    int child;
+    unsigned char byte;
+} trieEdge;
+
+static trieEdge* edges = NULL;
+static size_t edgeCapacity = 0;     //always a power of 2
+static size_t edgeCount = 0;
+static const char** nodeColors = NULL;  //color for the suffix ending at each node, NULL if none
+static size_t nodeCount = 0;
+static size_t nodeCapacity = 0;
+
+static size_t edgeSlot(int parent, unsigned char byte){
+    return (((size_t)parent * 2654435761u) ^ ((size_t)byte * 40503u)) & (edgeCapacity - 1);
+}
+
+/**
+ * @brief Finds the child of a trie node along the edge for one byte
+ * @returns index of the child node, or -1 if there is no such edge
+ */
+static int findChild(int parent, unsigned char byte){
+    if(edgeCapacity == 0){
+        return -1;
+    }
+    for(size_t slot = edgeSlot(parent,byte);; slot = (slot + 1) & (edgeCapacity - 1)){
+        if(edges[slot].parent == -1){
+            return -1;
+        }
+        if(edges[slot].parent == parent && edges[slot].byte == byte){
+            return edges[slot].child;
+        }
+    }
+}
+
+static void insertEdge(trieEdge edge){
+    size_t slot = edgeSlot(edge.parent,edge.byte);
+    while(edges[slot].parent != -1){
+        slot = (slot + 1) & (edgeCapacity - 1);
+    }
+    edges[slot] = edge;
+}
+
+//keeps the edge table at most half full
+static void growEdges(void){
+    size_t oldCapacity = edgeCapacity;
+    trieEdge* oldEdges = edges;
+    edgeCapacity = oldCapacity ? oldCapacity * 2 : 256;
+    edges = malloc(edgeCapacity*sizeof(trieEdge));
+    for(size_t i = 0; i < edgeCapacity; i++){
+        edges[i].parent = -1;
+    }
+    for(size_t i = 0; i < oldCapacity; i++){
+        if(oldEdges[i].parent != -1){
+            insertEdge(oldEdges[i]);
+        }
+    }
+    free(oldEdges);
+}
+
+static int newNode(void){
+    if(nodeCount == nodeCapacity){
+        nodeCapacity = nodeCapacity ? nodeCapacity * 2 : 64;
+        nodeColors = realloc(nodeColors,nodeCapacity*sizeof(*nodeColors));
+    }
+    nodeColors[nodeCount] = NULL;
+    return (int)nodeCount++;
+}
+
+/**
+ * @brief Adds a suffix rule to the trie. A later rule for the same suffix replaces the earlier one.
+ * @param suffix: The end of the file name the rule matches, without the leading '*'
+ * @param color: SGR code used for matching names
+ */
+static void addSuffixRule(const char* suffix, const char* color){
+    if(nodeCount == 0){
+        newNode();  //root
+    }
+    int node = 0;
+    for(size_t i = strlen(suffix); i > 0; i--){
+        unsigned char byte = (unsigned char)suffix[i-1];
+        int child = findChild(node,byte);
+        if(child == -1){
+            if((edgeCount + 1) * 2 > edgeCapacity){
+                growEdges();
+            }
+            child = newNode();
+            trieEdge edge = {node, child, byte};
+            insertEdge(edge);
+            edgeCount++;
+        }
+        node = child;
+    }
+    nodeColors[node] = color;
+}
+
+/**
+ * @brief Looks up the longest suffix rule matching the end of a name
+ * @returns the color of the rule, or NULL if no rule matches
+ */
+static const char* matchSuffix(const char* name, size_t nameLen){
+    if(nodeCount == 0){
+        return NULL;
+    }
+    const char* color = NULL;
+    int node = 0;
+    for(size_t i = nameLen; i > 0; i--){
+        node = findChild(node,(unsigned char)name[i-1]);
+        if(node == -1){
+            break;
+        }
+        if(nodeColors[node] != NULL){
+            color = nodeColors[node];
+        }
+    }
+    return color;
+}
+
+/**
+ * @brief Reads one key or value out of LS_COLORS, decoding escapes in place
+ * @param input: Where to start reading. Moved past the field and its terminator
+ * @param output: Where the decoded field is written. Can be the same buffer as the input,
+ * since the decoded field is never longer than the encoded one
+ * @param stopAt: '=' for keys, ':' for values
+ * @returns true if the field was read, false if the string is malformed
+ */
+static bool readField(char** input, char** output, char stopAt){
+    char* in = *input;
+    char* out = *output;
+    while(*in != '\0' && *in != stopAt && !(stopAt == '=' && *in == ':')){
+        if(*in == '\\'){
+            in++;
+            switch(*in){
+                case 'a': *out++ = '\a'; in++; break;
+                case 'b': *out++ = '\b'; in++; break;
+                case 'e': *out++ = 27; in++; break;
+                case 'f': *out++ = '\f'; in++; break;
+                case 'n': *out++ = '\n'; in++; break;
+                case 'r': *out++ = '\r'; in++; break;
+                case 't': *out++ = '\t'; in++; break;
+                case 'v': *out++ = '\v'; in++; break;
+                case '?': *out++ = 127; in++; break;
+                case '_': *out++ = ' '; in++; break;
+                case 'x': {
+                    in++;
+                    int value = 0, digits = 0;
+                    while(digits < 2 && ((*in >= '0' && *in <= '9') || (*in >= 'a' && *in <= 'f') || (*in >= 'A' && *in <= 'F'))){
+                        value = value*16 + (*in <= '9' ? *in - '0' : (*in | 0x20) - 'a' + 10);
+                        in++;
+                        digits++;
+                    }
+                    *out++ = (char)value;
+                    break;
+                }
+                case '\0':
+                    return false;
+                default:
+                    if(*in >= '0' && *in <= '7'){
+                        int value = 0, digits = 0;
+                        while(digits < 3 && *in >= '0' && *in <= '7'){
+                            value = value*8 + (*in - '0');
+                            in++;
+                            digits++;
+                        }
+                        *out++ = (char)value;
+                    }
+                    else {
+                        *out++ = *in++;
+                    }
+                    break;
+            }
+        }
+        else if(*in == '^'){
+            in++;
+            if(*in == '?'){
+                *out++ = 127;
+            }
+            else if(*in >= '@' && *in <= '~'){
+                *out++ = *in & 0x1F;
+            }
+            else {
+                return false;
+            }
+            in++;
+        }
+        else {
+            *out++ = *in++;
+        }
+    }
+    if(stopAt == '=' && *in != '='){
+        return false;
+    }
+    if(*in != '\0'){
+        in++;
+    }
+    *out++ = '\0';
+    *input = in;
+    *output = out;
+    return true;
+}
+
+/**
+ * @brief Parses LS_COLORS into the indicator table and the suffix trie.
+ * The decoded keys and values are kept in one buffer that lives for the rest of the program.
+ */
+static void parseColors(const char* spec){
+    char* buffer = strdup(spec);
+    char* in = buffer;
+    char* out = buffer;
+    while(*in != '\0'){
+        if(*in == ':'){
+            in++;
+            continue;
+        }
+        char* key = out;
+        if(readField(&in,&out,'=') == false){
+            //skip to the next pair
+            while(*in != '\0' && *in != ':'){
+                in++;
+            }
+            continue;
+        }
+        char* value = out;
+        if(readField(&in,&out,':') == false){
+            break;
+        }
+        if(key[0] == '*'){
+            addSuffixRule(key+1,value);
+            continue;
+        }
+        for(int i = 0; i < IND_COUNT; i++){
+            if(strcmp(key,indicatorNames[i]) == 0){
+                indicators[i] = value;
+                break;
+            }
+        }
+    }
+    if(indicators[IND_LN] != NULL && strcmp(indicators[IND_LN],"target") == 0){
+        linkAsTarget = true;
+        indicators[IND_LN] = NULL;
+    }
+}
+
+/**
+ * @brief Sets up coloring. Colors are only used when stdout is a terminal, otherwise
+ * LS_COLORS is not even read.
+ */
+void initColors(void){
+    enabled = isatty(STDOUT_FILENO);
+    if(!enabled){
+        return;
+    }
+    //LS_COLORS only replaces the keys it names, everything else keeps its default
+    memcpy(indicators,defaultIndicators,sizeof(indicators));
+    const char* spec = getenv("LS_COLORS");
+    if(spec != NULL && spec[0] != '\0'){
+        parseColors(spec);
+    }
+}
+
+bool colorsEnabled(void){
+    return enabled;
+}
+
+//empty values and "0" mean the same thing as no color at all
+static const char* usable(const char* color){
+    if(color == NULL || color[0] == '\0' || strcmp(color,"0") == 0 || strcmp(color,"00") == 0){
+        return NULL;
+    }
+    return color;
+}
+
+/**
+ * @brief Gets the color code for a file
+ * @param name: File name, used for the suffix rules
+ * @param nameLen: Length of name in bytes
+ * @param mode: st_mode from lstat()
+ * @param targetMode: If the file is a link, st_mode of the file it points to. 0 if the link is broken
+ * @returns the SGR code to use, or NULL for no color
+ */
+const char* colorForFile(const char* name, size_t nameLen, mode_t mode, mode_t targetMode){
+    if(!enabled){
+        return NULL;
+    }
+    if(S_ISLNK(mode)){
+        if(targetMode == 0 && usable(indicators[IND_OR]) != NULL){
+            return indicators[IND_OR];
+        }
+        if(linkAsTarget && targetMode != 0){
+            return colorForFile(name,nameLen,targetMode,0);
+        }
+        return usable(indicators[IND_LN]);
+    }
+    if(S_ISDIR(mode)){
+        if((mode & S_ISVTX) && (mode & S_IWOTH) && usable(indicators[IND_TW]) != NULL){
+            return indicators[IND_TW];
+        }
+        if((mode & S_IWOTH) && usable(indicators[IND_OW]) != NULL){
+            return indicators[IND_OW];
+        }
+        if((mode & S_ISVTX) && usable(indicators[IND_ST]) != NULL){
+            return indicators[IND_ST];
+        }
+        return usable(indicators[IND_DI]);
+    }
+    if(S_ISREG(mode)){
+        if((mode & S_ISUID) && usable(indicators[IND_SU]) != NULL){
+            return indicators[IND_SU];
+        }
+        if((mode & S_ISGID) && usable(indicators[IND_SG]) != NULL){
+            return indicators[IND_SG];
+        }
+        if((mode & (S_IXUSR|S_IXGRP|S_IXOTH)) && usable(indicators[IND_EX]) != NULL){
+            return indicators[IND_EX];
+        }
+        const char* suffixColor = usable(matchSuffix(name,nameLen));
+        if(suffixColor != NULL){
+            return suffixColor;
+        }
+        return usable(indicators[IND_FI]);
+    }
+    if(S_ISFIFO(mode)){
+        return usable(indicators[IND_PI]);
+    }
+    if(S_ISSOCK(mode)){
+        return usable(indicators[IND_SO]);
+    }
+    if(S_ISBLK(mode)){
+        return usable(indicators[IND_BD]);
+    }
+    if(S_ISCHR(mode)){
+        return usable(indicators[IND_CD]);
+    }
+    return usable(indicators[IND_NO]);
+}
+
+/**
+ * @brief Gets the color code for the "-> target" part of a link in long listing format
+ * @param targetMode: st_mode of the file the link points to. 0 if the link is broken
+ */
+const char* colorForLinkTarget(const char* target, size_t targetLen, mode_t targetMode){
+    if(!enabled){
+        return NULL;
+    }
+    if(targetMode == 0){
+        return usable(indicators[IND_MI]);
+    }
+    return colorForFile(target,targetLen,targetMode,0);
+}
+
+/**
+ * @brief Prints text wrapped in the escape sequences for a color
+ * @param out: Where the text is written
+ * @param color: Code from colorForFile(). If NULL, the text is printed as is
+ */
+void printColored(FILE* out, const char* text, const char* color){
+    if(color == NULL){
+        fputs(text,out);
+        return;
+    }
+    fputs(indicators[IND_LC],out);
+    fputs(color,out);
+    fputs(indicators[IND_RC],out);
+    fputs(text,out);
+    if(indicators[IND_EC] != NULL){
+        fputs(indicators[IND_EC],out);
+    }
+    else {
+        fputs(indicators[IND_LC],out);
+        fputs(indicators[IND_RS] != NULL ? indicators[IND_RS] : "0",out);
+        fputs(indicators[IND_RC],out);
+    }
+}
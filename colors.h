@@ -0,0 +1,22 @@
+#ifndef COLORS_H
+#define COLORS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+//LS_COLORS handling. The environment variable is parsed once by initColors(), after that
+//all the lookups are read only.
+
+void initColors(void);
+
+bool colorsEnabled(void);
+
+const char* colorForFile(const char* name, size_t nameLen, mode_t mode, mode_t targetMode);
+
+const char* colorForLinkTarget(const char* target, size_t targetLen, mode_t targetMode);
+
+void printColored(FILE* out, const char* text, const char* color);
+
+#endif
@@ -0,0 +1,197 @@
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "lsinternal.h"
+
+/*
+    A long running process (ls --server) lists the same directories over and over.
+    The names in a directory only change when the directory itself is modified, so the
+    readdir() results are kept and reused as long as the directory's device, inode, mtime and
+    ctime are unchanged. Entries are still lstat'ed on every listing, since a file can change
+    without its directory changing.
+
+    A directory modified in the last couple of seconds is not cached, because a second change
+    within the same timestamp tick would not be noticed.
+*/
+
+#define RACY_SECONDS 2
+
+typedef struct cachedDir {
+    char* path;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    struct timespec ctime;
+    dirNames* names;
+    unsigned long lastUsed;     //for evicting the least recently used directory
+} cachedDir;
+
+struct lsDirCache {
+    pthread_mutex_t lock;
+    cachedDir* dirs;
+    size_t count;
+    size_t maxDirs;
+    unsigned long clock;
+};
+
+/**
+ * @brief Makes a cache for directory reads
+ * @param maxDirs: How many directories are kept at most. The least recently used one is dropped first
+ */
+lsDirCache* lsDirCacheNew(size_t maxDirs){
+    lsDirCache* cache = calloc(1,sizeof(lsDirCache));
+    pthread_mutex_init(&cache->lock,NULL);
+    cache->maxDirs = maxDirs > 0 ? maxDirs : 1;
+    cache->dirs = calloc(cache->maxDirs,sizeof(cachedDir));
+    return cache;
+}
+
+static void freeNames(dirNames* names){
+    free(names->names);
+    free(names);
+}
+
+//drops the cache's reference. Must hold the lock
+static void dropNames(dirNames* names){
+    names->refs--;
+    if(names->refs == 0){
+        freeNames(names);
+    }
+}
+
+void lsDirCacheFree(lsDirCache* cache){
+    if(cache == NULL){
+        return;
+    }
+    for(size_t i = 0; i < cache->count; i++){
+        free(cache->dirs[i].path);
+        dropNames(cache->dirs[i].names);
+    }
+    free(cache->dirs);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static bool sameTime(struct timespec a, struct timespec b){
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+/**
+ * @brief Reads every name in a directory, including . and ..
+ * @returns the names with one reference, or NULL with error set
+ */
+static dirNames* readNames(const char* dir, int* error){
+    DIR* dp = opendir(dir);
+    if(!dp){
+        *error = errno;
+        return NULL;
+    }
+    size_t used = 0, capacity = 4096;
+    dirNames* names = calloc(1,sizeof(dirNames));
+    names->names = malloc(capacity);
+    struct dirent* dirp;
+    while((dirp = readdir(dp)) != NULL){
+        size_t len = strnlen(dirp->d_name,256) + 1;
+        if(used + len > capacity){
+            capacity *= 2;
+            names->names = realloc(names->names,capacity);
+        }
+        memcpy(names->names+used,dirp->d_name,len);
+        used += len;
+        names->count++;
+    }
+    closedir(dp);
+    names->refs = 1;
+    return names;
+}
+
+/**
+ * @brief Gets the names in a directory, from the cache if the directory hasn't changed since it was read
+ * @param cache: The cache to look in and fill
+ * @param dir: Path to the directory
+ * @param error: Set to errno if the directory can't be read
+ * @returns the names, or NULL on error. Give them back with dirCacheRelease()
+ */
+dirNames* dirCacheGet(lsDirCache* cache, const char* dir, int* error){
+    struct stat dirStat;
+    if(stat(dir,&dirStat) == -1){
+        *error = errno;
+        return NULL;
+    }
+    pthread_mutex_lock(&cache->lock);
+    cachedDir* entry = NULL;
+    for(size_t i = 0; i < cache->count; i++){
+        if(strcmp(cache->dirs[i].path,dir) == 0){
+            entry = &cache->dirs[i];
+            break;
+        }
+    }
+    if(entry != NULL && entry->dev == dirStat.st_dev && entry->ino == dirStat.st_ino &&
+        sameTime(entry->mtime,dirStat.st_mtim) && sameTime(entry->ctime,dirStat.st_ctim)){
+        entry->lastUsed = ++cache->clock;
+        entry->names->refs++;
+        dirNames* names = entry->names;
+        pthread_mutex_unlock(&cache->lock);
+        return names;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    //read outside the lock, so other directories can be listed in the meantime
+    dirNames* names = readNames(dir,error);
+    if(names == NULL){
+        return NULL;
+    }
+    if(time(NULL) - dirStat.st_mtim.tv_sec < RACY_SECONDS){
+        return names;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    //look again, someone else may have changed the cache while we were reading
+    entry = NULL;
+    for(size_t i = 0; i < cache->count; i++){
+        if(strcmp(cache->dirs[i].path,dir) == 0){
+            entry = &cache->dirs[i];
+            break;
+        }
+    }
+    if(entry == NULL && cache->count < cache->maxDirs){
+        entry = &cache->dirs[cache->count++];
+        entry->path = strdup(dir);
+        entry->names = NULL;
+    }
+    else if(entry == NULL){
+        //replace the least recently used directory
+        entry = &cache->dirs[0];
+        for(size_t i = 1; i < cache->count; i++){
+            if(cache->dirs[i].lastUsed < entry->lastUsed){
+                entry = &cache->dirs[i];
+            }
+        }
+        free(entry->path);
+        entry->path = strdup(dir);
+    }
+    if(entry->names != NULL){
+        dropNames(entry->names);
+    }
+    entry->dev = dirStat.st_dev;
+    entry->ino = dirStat.st_ino;
+    entry->mtime = dirStat.st_mtim;
+    entry->ctime = dirStat.st_ctim;
+    entry->names = names;
+    entry->lastUsed = ++cache->clock;
+    names->refs++;      //one for the cache, one for the caller
+    pthread_mutex_unlock(&cache->lock);
+    return names;
+}
+
+//gives back names from dirCacheGet()
+void dirCacheRelease(lsDirCache* cache, dirNames* names){
+    pthread_mutex_lock(&cache->lock);
+    dropNames(names);
+    pthread_mutex_unlock(&cache->lock);
+}
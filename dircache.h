@@ -0,0 +1,13 @@
+#ifndef LS_DIRCACHE_H
+#define LS_DIRCACHE_H
+
+#include <stddef.h>
+
+//keeps the readdir() results of recently listed directories, see dircache.c
+typedef struct lsDirCache lsDirCache;
+
+lsDirCache* lsDirCacheNew(size_t maxDirs);
+
+void lsDirCacheFree(lsDirCache* cache);
+
+#endif
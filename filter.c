@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <errno.h>
+#include <limits.h>
+#include "lsinternal.h"
+
+/*
+    Filters are applied in two steps while a directory is read:
+    1. filterName() runs on d_name, before the entry is stat'ed or anything is allocated for it.
+    2. filterStat() runs right after lstat(), before the name is copied or long listing info is built.
+    So an entry that gets filtered out costs a name compare, plus one lstat() if there are size or time predicates.
+*/
+
+//true if the character makes a glob more than a plain string
+static bool isGlobChar(char c){
+    return c == '*' || c == '?' || c == '[' || c == '\\';
+}
+
+/**
+ * @brief Works out the cheapest way to match a glob. Patterns that are a literal with a '*'
+ * on one or both ends are matched with memcmp/strstr instead of fnmatch()
+ * @param glob: The pattern from the command line
+ */
+static lsNamePattern compilePattern(const char* glob){
+    lsNamePattern pattern;
+    size_t len = strlen(glob);
+    bool leadingStar = len > 0 && glob[0] == '*';
+    bool trailingStar = len > 1 && glob[len-1] == '*';
+    size_t start = leadingStar ? 1 : 0;
+    size_t end = trailingStar ? len - 1 : len;
+
+    bool literal = true;
+    for(size_t i = start; i < end; i++){
+        if(isGlobChar(glob[i])){
+            literal = false;
+            break;
+        }
+    }
+    if(!literal){
+        pattern.kind = LS_MATCH_GLOB;
+        pattern.text = strdup(glob);
+        pattern.len = len;
+        return pattern;
+    }
+    if(leadingStar && (len == 1 || (trailingStar && len == 2))){
+        pattern.kind = LS_MATCH_ANY;
+    }
+    else if(leadingStar && trailingStar){
+        pattern.kind = LS_MATCH_CONTAINS;
+    }
+    else if(leadingStar){
+        pattern.kind = LS_MATCH_SUFFIX;
+    }
+    else if(trailingStar){
+        pattern.kind = LS_MATCH_PREFIX;
+    }
+    else {
+        pattern.kind = LS_MATCH_EXACT;
+    }
+    pattern.text = strndup(glob+start,end-start);
+    pattern.len = end - start;
+    return pattern;
+}
+
+/**
+ * @brief Compiles a glob and adds it to the include or exclude list
+ * @param filters: The filter set to add to
+ * @param glob: Shell style pattern matched against file names
+ * @param include: true for --include, false for --exclude
+ */
+void lsAddNamePattern(lsFilterSet* filters, const char* glob, bool include){
+    lsNamePattern** list = include ? &filters->includes : &filters->excludes;
+    int* count = include ? &filters->includeCount : &filters->excludeCount;
+    *list = realloc(*list,(*count+1)*sizeof(lsNamePattern));
+    (*list)[*count] = compilePattern(glob);
+    (*count)++;
+}
+
+static bool matchPattern(const lsNamePattern* pattern, const char* name, size_t nameLen){
+    switch(pattern->kind){
+        case LS_MATCH_ANY:
+            return true;
+        case LS_MATCH_EXACT:
+            return nameLen == pattern->len && memcmp(name,pattern->text,nameLen) == 0;
+        case LS_MATCH_PREFIX:
+            return nameLen >= pattern->len && memcmp(name,pattern->text,pattern->len) == 0;
+        case LS_MATCH_SUFFIX:
+            return nameLen >= pattern->len && memcmp(name+nameLen-pattern->len,pattern->text,pattern->len) == 0;
+        case LS_MATCH_CONTAINS:
+            return strstr(name,pattern->text) != NULL;
+        case LS_MATCH_GLOB:
+            return fnmatch(pattern->text,name,0) == 0;
+    }
+    return false;
+}
+
+/**
+ * @brief Parses a size like 500, 10K, 4M or 2G. Suffixes are powers of 1024
+ * @param text: The size from the command line
+ * @param size: Set to the size in bytes
+ * @returns false if text is not a valid size, or too big for an off_t
+ */
+bool lsParseSize(const char* text, off_t* size){
+    char* end;
+    errno = 0;
+    long long value = strtoll(text,&end,10);
+    if(end == text || value < 0 || errno != 0){
+        return false;
+    }
+    const char* units = "KMGTP";
+    if(*end != '\0'){
+        char upper = *end & ~0x20;     //accept lowercase units too
+        const char* unit = upper != '\0' ? strchr(units,upper) : NULL;
+        if(unit == NULL || end[1] != '\0'){
+            return false;
+        }
+        for(long i = 0; i <= unit - units; i++){
+            if(value > LLONG_MAX/1024){
+                return false;
+            }
+            value *= 1024;
+        }
+    }
+    if((off_t)value != value){
+        return false;
+    }
+    *size = (off_t)value;
+    return true;
+}
+
+/**
+ * @brief Parses an age like 90, 30m, 1h, 2d or 1w and turns it into a timestamp
+ * @param text: The age from the command line. A plain number is seconds
+ * @param now: Current time, the age is counted back from here
+ * @param cutoff: Set to now minus the age
+ * @returns false if text is not a valid age, or too far back for a time_t
+ */
+bool lsParseAge(const char* text, time_t now, time_t* cutoff){
+    char* end;
+    errno = 0;
+    long long value = strtoll(text,&end,10);
+    if(end == text || value < 0 || errno != 0){
+        return false;
+    }
+    long long seconds = 1;
+    if(*end != '\0'){
+        switch(*end){
+            case 's': seconds = 1; break;
+            case 'm': seconds = 60; break;
+            case 'h': seconds = 60*60; break;
+            case 'd': seconds = 24*60*60; break;
+            case 'w': seconds = 7*24*60*60; break;
+            default: return false;
+        }
+        if(end[1] != '\0'){
+            return false;
+        }
+    }
+    if(value > LLONG_MAX/seconds){
+        return false;
+    }
+    long long age = value*seconds;
+    //now is after 1970, so now - age can't go below the bottom of time_t's range once age fits in one
+    if((time_t)age != age){
+        return false;
+    }
+    *cutoff = now - (time_t)age;
+    return true;
+}
+
+//if entries need to be stat'ed before we know whether to list them
+bool hasStatFilters(const lsFilterSet* filters){
+    return filters->hasMinSize || filters->hasMaxSize || filters->hasNewer || filters->hasOlder;
+}
+
+/**
+ * @brief Runs the include and exclude patterns against a file name
+ * @param name: d_name of the entry
+ * @param nameLen: length of name
+ * @returns true if the entry should be kept
+ */
+bool filterName(const lsFilterSet* filters, const char* name, size_t nameLen){
+    for(int i = 0; i < filters->excludeCount; i++){
+        if(matchPattern(&filters->excludes[i],name,nameLen)){
+            return false;
+        }
+    }
+    if(filters->includeCount == 0){
+        return true;
+    }
+    for(int i = 0; i < filters->includeCount; i++){
+        if(matchPattern(&filters->includes[i],name,nameLen)){
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Runs the size and time predicates against an entry's lstat() result
+ * @returns true if the entry should be kept
+ */
+bool filterStat(const lsFilterSet* filters, const struct stat* fileStat){
+    if(filters->hasMinSize && fileStat->st_size < filters->minSize){
+        return false;
+    }
+    if(filters->hasMaxSize && fileStat->st_size > filters->maxSize){
+        return false;
+    }
+    if(filters->hasNewer || filters->hasOlder){
+        time_t when = fileStat->st_mtime;
+        if(filters->timeField == LS_TIME_ATIME){
+            when = fileStat->st_atime;
+        }
+        else if(filters->timeField == LS_TIME_CTIME){
+            when = fileStat->st_ctime;
+        }
+        if(filters->hasNewer && when < filters->newerThan){
+            return false;
+        }
+        if(filters->hasOlder && when > filters->olderThan){
+            return false;
+        }
+    }
+    return true;
+}
+
+void lsFreeFilters(lsFilterSet* filters){
+    for(int i = 0; i < filters->includeCount; i++){
+        free(filters->includes[i].text);
+    }
+    for(int i = 0; i < filters->excludeCount; i++){
+        free(filters->excludes[i].text);
+    }
+    free(filters->includes);
+    free(filters->excludes);
+    filters->includes = NULL;
+    filters->excludes = NULL;
+    filters->includeCount = 0;
+    filters->excludeCount = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef LS_FILTER_H
+#define LS_FILTER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+//how a name pattern is matched. Simple globs are turned into plain string compares
+typedef enum lsMatchKind {
+    LS_MATCH_ANY,      // *
+    LS_MATCH_EXACT,    // name
+    LS_MATCH_PREFIX,   // name*
+    LS_MATCH_SUFFIX,   // *.log
+    LS_MATCH_CONTAINS, // *name*
+    LS_MATCH_GLOB      //anything else, goes through fnmatch()
+} lsMatchKind;
+
+//one compiled --include or --exclude pattern
+typedef struct lsNamePattern {
+    lsMatchKind kind;
+    char* text;     //literal part of the pattern, or the full glob for LS_MATCH_GLOB
+    size_t len;     //length of text
+} lsNamePattern;
+
+//which timestamp the --newer and --older predicates look at
+typedef enum lsTimeField {
+    LS_TIME_MTIME,
+    LS_TIME_ATIME,     //-u
+    LS_TIME_CTIME      //-c
+} lsTimeField;
+
+//everything that decides if a directory entry gets listed, besides -a and -A
+typedef struct lsFilterSet {
+    lsNamePattern* includes;  //if any, a name has to match at least one of these
+    int includeCount;
+    lsNamePattern* excludes;  //a name matching any of these is skipped
+    int excludeCount;
+
+    bool hasMinSize;
+    off_t minSize;
+    bool hasMaxSize;
+    off_t maxSize;
+    bool hasNewer;
+    time_t newerThan;   //oldest allowed timestamp
+    bool hasOlder;
+    time_t olderThan;   //newest allowed timestamp
+    lsTimeField timeField;
+} lsFilterSet;
+
+void lsAddNamePattern(lsFilterSet* filters, const char* glob, bool include);
+
+bool lsParseSize(const char* text, off_t* size);
+
+bool lsParseAge(const char* text, time_t now, time_t* cutoff);
+
+void lsFreeFilters(lsFilterSet* filters);
+
+#endif
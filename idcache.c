@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <grp.h>
+#include "idcache.h"
+
+//one cached id. Numeric and named forms of the same id are cached separately
+typedef struct idName {
+    unsigned int id;
+    bool numeric;
+    char* name;
+} idName;
+
+typedef struct idTable {
+    idName* entries;
+    size_t count;
+    size_t capacity;
+} idTable;
+
+//a directory usually has files from just a few owners, so a short list is searched linearly
+static idTable users = {NULL, 0, 0};
+static idTable groups = {NULL, 0, 0};
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* findCached(idTable* table, unsigned int id, bool numeric){
+    for(size_t i = 0; i < table->count; i++){
+        if(table->entries[i].id == id && table->entries[i].numeric == numeric){
+            return table->entries[i].name;
+        }
+    }
+    return NULL;
+}
+
+static const char* addCached(idTable* table, unsigned int id, bool numeric, char* name){
+    if(table->count == table->capacity){
+        table->capacity = table->capacity ? table->capacity * 2 : 16;
+        table->entries = realloc(table->entries,table->capacity*sizeof(idName));
+    }
+    table->entries[table->count].id = id;
+    table->entries[table->count].numeric = numeric;
+    table->entries[table->count].name = name;
+    table->count++;
+    return name;
+}
+
+static char* idToString(unsigned int id){
+    char buffer[16];
+    snprintf(buffer,sizeof(buffer),"%u",id);
+    return strdup(buffer);
+}
+
+//size of the scratch buffer for getpwuid_r/getgrgid_r
+static size_t nssBufferSize(int name){
+    long size = sysconf(name);
+    return size > 0 ? (size_t)size : 1024;
+}
+
+/**
+ * @brief Looks up the name of a user. Ids that have no name are shown as numbers
+ * @param uid: The user id
+ * @param numeric: If true, the id itself is returned as a string (-n)
+ */
+const char* userName(uid_t uid, bool numeric){
+    pthread_mutex_lock(&cacheLock);
+    const char* cached = findCached(&users,uid,numeric);
+    if(cached != NULL){
+        pthread_mutex_unlock(&cacheLock);
+        return cached;
+    }
+    char* name = NULL;
+    if(!numeric){
+        size_t bufferSize = nssBufferSize(_SC_GETPW_R_SIZE_MAX);
+        char* buffer = malloc(bufferSize);
+        struct passwd pwd;
+        struct passwd* result = NULL;
+        int error;
+        while((error = getpwuid_r(uid,&pwd,buffer,bufferSize,&result)) == ERANGE){
+            bufferSize *= 2;
+            buffer = realloc(buffer,bufferSize);
+        }
+        if(error == 0 && result != NULL){
+            name = strdup(result->pw_name);
+        }
+        free(buffer);
+    }
+    if(name == NULL){
+        name = idToString(uid);
+    }
+    const char* added = addCached(&users,uid,numeric,name);
+    pthread_mutex_unlock(&cacheLock);
+    return added;
+}
+
+/**
+ * @brief Looks up the name of a group. Ids that have no name are shown as numbers
+ * @param gid: The group id
+ * @param numeric: If true, the id itself is returned as a string (-n)
+ */
+const char* groupName(gid_t gid, bool numeric){
+    pthread_mutex_lock(&cacheLock);
+    const char* cached = findCached(&groups,gid,numeric);
+    if(cached != NULL){
+        pthread_mutex_unlock(&cacheLock);
+        return cached;
+    }
+    char* name = NULL;
+    if(!numeric){
+        size_t bufferSize = nssBufferSize(_SC_GETGR_R_SIZE_MAX);
+        char* buffer = malloc(bufferSize);
+        struct group grp;
+        struct group* result = NULL;
+        int error;
+        while((error = getgrgid_r(gid,&grp,buffer,bufferSize,&result)) == ERANGE){
+            bufferSize *= 2;
+            buffer = realloc(buffer,bufferSize);
+        }
+        if(error == 0 && result != NULL){
+            name = strdup(result->gr_name);
+        }
+        free(buffer);
+    }
+    if(name == NULL){
+        name = idToString(gid);
+    }
+    const char* added = addCached(&groups,gid,numeric,name);
+    pthread_mutex_unlock(&cacheLock);
+    return added;
+}
+
+//frees every cached name. Strings handed out before this are no longer valid
+void lsIdCacheClear(void){
+    pthread_mutex_lock(&cacheLock);
+    idTable* tables[] = {&users, &groups};
+    for(int t = 0; t < 2; t++){
+        for(size_t i = 0; i < tables[t]->count; i++){
+            free(tables[t]->entries[i].name);
+        }
+        free(tables[t]->entries);
+        tables[t]->entries = NULL;
+        tables[t]->count = 0;
+        tables[t]->capacity = 0;
+    }
+    pthread_mutex_unlock(&cacheLock);
+}
@@ -0,0 +1,14 @@
+#ifndef IDCACHE_H
+#define IDCACHE_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+//uid/gid to name lookups for the long listing. Each id only goes through NSS once, and the
+//returned strings stay valid until lsIdCacheClear()
+
+const char* userName(uid_t uid, bool numeric);
+
+const char* groupName(gid_t gid, bool numeric);
+
+#endif
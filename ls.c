@@ -1,19 +1,20 @@
-#include <dirent.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>        //strcasecmp
 #include <stddef.h>
-#include <pwd.h>
-#include <grp.h>
-#include <linux/limits.h>
+#include <stdint.h>
 #include <errno.h>
+#include <limits.h>
+#include <ctype.h>
 #include <sys/ioctl.h>
 #include <time.h>
 #include <math.h>
+#include <pthread.h>
 #include <getopt.h>
 #include "ls.h"
+#include "colors.h"
 
 /*
     Flags implemented:
@@ -28,6 +29,8 @@
     -t: Sort by time modified (most recently modified first) before sorting the operands by lexicographical
 order.
     -u: Use time of last access, instead of last modification of the file for sorting ( −t ) or printing ( −l ) 
+    -@: With -l, put + after the permissions of files with an ACL, and @ after files with other extended attributes.
+    -Z: With -l, print each file's SELinux security context after the group, or ? if it has none.
 
     Flags to do:
     -c: Use time when file status was last changed, instead of time of last modification of the file for 
@@ -50,299 +53,43 @@ BLOCKSIZE (see ENVIRONMENT) where partial units are rounded up to the next integ
 If the output is to a terminal, a total sum for all the file sizes is output on a line before the listing.
 
     -w: Force raw printing of non-printable characters. This is the default when output is not to a terminal.
-*/
-
-/**
- * @brief Counts how many digits are in the input number
- * @param num: The input number that the number of digits will be calculated for
- */
-int countDigits(int num){
-    if(num == 0){
-        return 1;
-    }
-    int digits = 1;
-    int num1 = abs(num);
-    while((num1 /= 10)>0){
-        digits++;
-    }
-    //add a digit for a negatve number (sentinel value)
-    if(num<0){
-        // digits++;
-    }
-    return digits;
-}
 
-/**
-    * @brief Takes in argc and argv, and a bunch of buffers. Sets those buffers to be flags, dirs, and count of each
-    * @param argc: number of arguments passed via command line
-    * @param argv: argv
-    * @param outputFlags: A string where each index is a flag passed in through argv
-    * @param outputTargets: A 2D array for every command line argument that is not a flag. Everything we want to actually list.
-    * @param flagCount: The number of flags. Set by the function.
-    * @param argTargetCount: The number of directories passed in through argv
+    Filtering options:
+    -I, --exclude, --ignore PATTERN: Do not list names matching the shell pattern. Can be given more than once.
+    --include PATTERN: Only list names matching the shell pattern. Can be given more than once.
+    --min-size, --max-size SIZE: Only list files at least/at most SIZE bytes. K, M, G, T, P suffixes are powers of 1024.
+    --newer, --older AGE: Only list files modified less/more than AGE ago. AGE is seconds, or a number ending in
+s, m, h, d or w. With -u or -c the access or status change time is used instead.
+
+    Paging options:
+    --offset N: Leave out the first N entries of each listing.
+    --limit N: List at most N entries of each listing. Only that many are kept in memory.
+    --cursor CURSOR: With -f and one directory, carry on where an earlier --limit page stopped. When a -f page
+stops before the end of the directory, the cursor for the next page is written to stderr.
+
+    Snapshot options (see snapshot.h):
+    --snapshot FILE: Save the listings to FILE in a compact binary form instead of printing them.
+    --diff FILE: Scan the directories saved in FILE again and print one line per entry that changed:
++ for added, - for removed and M for modified, followed by the fields that changed. Exits with 1 if
+anything changed. Use the same -a/-A and filtering options the snapshot was written with.
+
+    Server options (see server.c):
+    --server PATH: Listen on a Unix domain socket and answer listing requests until killed.
+    --threads N: Number of requests the server works on at the same time. Default 4.
+    --connect PATH: Send the rest of the command line to a server and print its reply.
+    --binary: Write a binary record stream instead of text (see server.h).
 */
-void getFlagsAndDirs(int argc, char** const argv, char* outputFlags, char** outputTargets, int* flagCount, int* argTargetCount){
-    for(int i = 0; i < argc; i++){    //loop over each arg in argv
-        bool isFlag = false;
-        if(argv[i][0] == '-'){
-            isFlag = true;
-        }
-        //loop over each character in a given argument
-        for(int j = 0; j < strnlen(argv[i],1024); j++){
-            if(isFlag && argv[i][j] != '-'){
-                (outputFlags[*flagCount]) = argv[i][j];
-                // printf("flag: %c\n",outputFlags[*flagCount]);
-                (*flagCount)++;
-            }
-        }
-        if(isFlag == false && i>0){
-            (outputTargets[*argTargetCount]) = strndup(argv[i],1024);
-            // printf("dir: %s\n",outputTargets[*argTargetCount]);
-            (*argTargetCount)++;
-        }
-    }
-    // printf("Output flags: %s\n",outputFlags);2
-}
 
 /**
- * @brief Checks if item is a link using S_ISLNK. Only sets item as a link if S_ISLNK is true,
- * and the file it points to makes sense
- * @param item: item we check link status and update link information for.
- * @param fileStat: stat of the file. used to check for link and to get handle to link endpoint
- * @param secondCall: If this is the second time calling this function per one file. If so,
- * don't reassign item->link, as that created a memory leak
- * @returns if item should be considered a link
+ * @brief Gets the LS_COLORS color for an item's name. Only used by the color printers
+ * @param item: The item being printed
+ * @returns the color code, or NULL if the name is printed without color
  */
-void getLinkInfo(itemInDir* item, struct stat fileStat, bool secondCall){
-    item->isLink = false;
-    if(S_ISLNK(fileStat.st_mode)){
-        char* pointsTo = calloc(256,1);
-        int nbytes = readlink(item->path,pointsTo,256);
-        char* pointsToPath = realpath(item->path,NULL);
-        // printf("Realpath: %s\n",pointsToPath);
-        if(nbytes != -1){
-            struct stat linkStat;
-            if(stat(pointsToPath,&linkStat)<0){
-                // fprintf(stderr,"stat(%s -> %s) on link endpoint failed: %s\n",item->path,pointsToPath,strerror(errno));
-                item->pointsToDir = false;
-                // free(pointsTo);
-                // free(pointsToPath);
-                // return;
-            }
-            if(secondCall == false)
-                item->link = calloc(nbytes+1,1);
-            strncpy(item->link,pointsTo,nbytes);
-            strcat(item->link,"\0");
-            if(S_ISDIR(linkStat.st_mode)){
-                // printf("%s points to dir %s\n",item->name,pointsTo);
-                item->pointsToDir = true;
-            }
-            // item->permissions[0] = 'l';
-        }
-        free(pointsTo);
-        free(pointsToPath);
-        item->isLink = true;
-        item->isDir = false;
-    }
-}
-/**
- * @brief Get information (for one file) used in long list format printing
- * @param item: A pointer to the item information struct. Modified by function.
- * @param folder: A handle to the current folder, used for getting the total blocks taken up by the items in the folder
- * @param flags: Used for -n, which specifies group and owner as numbers, not strings
- */
-void getLongListInfo(itemInDir* item, lsRequestedItem* folder, char* flags){
-    char permissions[] = "----------";
-    if(item->isDir == true){
-        permissions[0] = 'd';
-    }
-    item->permissions = malloc(sizeof(permissions));
+const char* itemColor(lsItem* item){
     if(item->lstatSuccessful == false){
-        // fprintf(stderr,"Error: lstat(%s) failed (long listing). %s\n",item->path,strerror(errno));
-        item->hardLinksCount = SENTINEL;
-        strncpy(item->permissions,"-?????????",11);
-        item->owner = "?";
-        item->group = "?";
-        item->itemStat.st_size = SENTINEL; //sentinel value
-        item->itemStat.st_mtime = SENTINEL;
-        return;
-    }
-    strcpy(&permissions[1], (item->itemStat.st_mode & S_IRUSR) ? "r" : "-");
-    strcpy(&permissions[2], (item->itemStat.st_mode & S_IWUSR) ? "w" : "-");
-    strcpy(&permissions[3], (item->itemStat.st_mode & S_IXUSR) ? "x" : "-");
-    strcpy(&permissions[4], (item->itemStat.st_mode & S_IRGRP) ? "r" : "-");
-    strcpy(&permissions[5], (item->itemStat.st_mode & S_IWGRP) ? "w" : "-");
-    strcpy(&permissions[6], (item->itemStat.st_mode & S_IXGRP) ? "x" : "-");
-    strcpy(&permissions[7], (item->itemStat.st_mode & S_IROTH) ? "r" : "-");
-    strcpy(&permissions[8], (item->itemStat.st_mode & S_IWOTH) ? "w" : "-");
-    strcpy(&permissions[9], (item->itemStat.st_mode & S_IXOTH) ? "x" : "-");
-
-    memcpy(item->permissions,permissions,sizeof(permissions));
-    item->hardLinksCount = item->itemStat.st_nlink;
-    keepMax(folder->widths.hardLinksWidth,countDigits(item->hardLinksCount));
-
-    struct passwd* pwd;
-    struct group* grp;
-
-    pwd = getpwuid(item->itemStat.st_uid);
-    grp = getgrgid(item->itemStat.st_gid);
-
-    if(item->lstatSuccessful == true){
-        char* owner = pwd->pw_name;
-        char* group = grp->gr_name;
-        if(nflag){
-            sprintf(owner,"%d",pwd->pw_uid);
-            sprintf(group,"%d",grp->gr_gid);
-        }
-        item->owner = owner;
-        item->group = group;
-        // item->size = item->itemStat.st_size;
-        // item->mtime = item->itemStat.st_mtime;
-
-        keepMax(folder->widths.ownerWidth,strnlen(item->owner,256));
-        keepMax(folder->widths.groupWidth,strnlen(item->group,256));
-        keepMax(folder->widths.sizeWidth,countDigits(item->itemStat.st_size));
-    }
-
-    folder->totalBlocks += (item->itemStat.st_blocks/2);
-    getLinkInfo(item,item->itemStat,true);
-    if(item->isLink == true){
-        item->permissions[0] = 'l';
-        item->isDir = false;
-    }
-    // printf("name: %s   blocks  %ld\n",item->name,fileStat.st_blocks);
-}
-
-/**
- * @brief In a given directory, which items do we need to run ls on
- * Also gives us the path to the items to make lstat() easier
- * @returns number of items to print. Accounts for -a and -A flags. Also checks if an item is a directory.
- * @param dir The current directory we are searching through 
- * @param flags Flags from argv. If 'a' or 'A' are in the flags, for example, that will affect the outputItems
- * @param outputItems The items in that folder that will be listed when the dir contents are printed
- */
-int whichItems(char* const dir, char* const flags, itemInDir* outputItems, lsRequestedItem* folder){
-    struct dirent* dirp;
-    DIR* dp;
-    dp = opendir(dir);
-    if(!dp){
-        //if we cannot open the directory, print the error immediately.
-        fprintf(stderr,"ls: cannot access '%s': %s",dir,strerror(errno));
-        return 0;
-    }
-    int dirIndex = 0;
-    while((dirp = readdir(dp)) != NULL){
-        //sets these to false so they are not set true by garbage values
-        outputItems[dirIndex].isDir = false;
-        outputItems[dirIndex].isLink = false;
-        //set name width padding to 0 to prepare for pretty printing
-        outputItems[dirIndex].nameWidthPadding = 0;
-
-        if(aflag == 0 && Aflag == 0 && fflag == 0){
-            //skip entries that start with .
-            if(dirp->d_name[0] == '.'){
-                continue;
-            }
-        }
-        if(Aflag != 0 && Aflag > aflag){
-            if(strcmp(dirp->d_name,".") == 0 || strcmp(dirp->d_name,"..") == 0){
-                continue;
-            }
-        }
-        char itemPath[PATH_MAX+1];      //+1 for newline
-        strncpy(itemPath,dir,PATH_MAX);
-        size_t dirnameLen = strnlen(dir,PATH_MAX-1);
-        if(itemPath[dirnameLen-1] != '/'){
-            itemPath[dirnameLen] = '/';
-            dirnameLen++;
-        }
-        strncat(itemPath,dirp->d_name,PATH_MAX);
-        (outputItems[dirIndex]).name = strndup(dirp->d_name,256);
-        (outputItems[dirIndex]).path = strndup(itemPath,PATH_MAX);
-    
-        // struct stat outputItems[dirIndex].itemStat;
-        if(lstat(outputItems[dirIndex].path,&outputItems[dirIndex].itemStat) == -1){
-            fprintf(stderr,"Error: lstat(%s) failed: %s\n",outputItems[dirIndex].path,strerror(errno));
-            outputItems[dirIndex].lstatSuccessful = false;
-            // dirIndex++;
-            // continue;
-        }
-        else {
-            outputItems[dirIndex].lstatSuccessful = true;
-        }
-        if(S_ISDIR(outputItems[dirIndex].itemStat.st_mode) == 1){
-            outputItems[dirIndex].isDir = true;
-        }
-        //getLinkInfo is called twice because sometimes S_ISLNK thinks something like .gitignore is a link
-        getLinkInfo(&outputItems[dirIndex],outputItems[dirIndex].itemStat,false);
-
-        // printf("is link?: %d\n",S_ISLNK(fileStat.st_mode));
-        // if(lflag || nflag){
-            getLongListInfo(&outputItems[dirIndex],folder,flags);
-        // }
-        dirIndex++;
-    }
-    closedir(dp);
-    return dirIndex;
-}
-
-/**
- * @brief The ls logic itself. Populates the structs above with information about folders and files in those 
- * folders so we can print them.
- * @param flags: The flags string. Currently, no functionality for flags is implemented yet
- * @param argTargetCount: number of lsTargets passed in through argv. Not all can be used, since some may not exist or have bad permissions.
- * @param printTargetCount: number of directories we actually print the contents of. Modified by the function.
- * @param lsTargets: A 2d array of all the directories/items we need to try to run ls on
- * @param folders: A (blank) array of structs that contains information we need for printing the contents of a folder. 
- *      Modified by function
-*/
-void ls(char* const flags, int argTargetCount, int* printTargetCount, char** const lsTargets, lsRequestedItem* folders){
-    struct dirent* dirp;
-    DIR* dp;
-    *printTargetCount = argTargetCount;
-    //main loop. ls for one directory at a time
-    for(int i = 0; i < argTargetCount; i++){       
-        //get number of items in the directory. We need this number so that we know how much space to alloc
-        //for the struct. Accounts for all items, even ones we don't print
-        size_t totalItemsInDir = 0;
-        dp = opendir(lsTargets[i]);
-        if(!dp){
-            //we cannot open this directory, so move on to the next one.   
-            fprintf(stderr,"ls: cannot access '%s': %s",lsTargets[i],strerror(errno));
-            if(i < argTargetCount){
-                printf("\n");
-            }
-            (*printTargetCount)--;
-            //If we cannot access the directory, we cannot print it
-            folders[i].doWePrint = false;
-            continue;
-        }
-        else{
-            //count number of items in the directory
-            while((dirp = readdir(dp)) != NULL){
-                totalItemsInDir++;
-            }
-        }
-         //if we pass more than one directory, list the path above the contents of that directory
-        if(dp != NULL && argTargetCount>1){      
-            folders[i].showPath = true;
-            //set the header equal to the dir path
-            folders[i].path = strndup(lsTargets[i],PATH_MAX);
-        }
-        else{
-            //valid folder, but just one, so don't list the path
-            folders[i].showPath = false;
-        }
-        closedir(dp);
-
-        //allocate space for info for each item in dir
-        folders[i].items = (itemInDir*)malloc(totalItemsInDir*sizeof(itemInDir));
-        // folders[i].widths = calloc(sizeof(widthInfo),1);
-        folders[i].itemCount = whichItems(lsTargets[i],flags,folders[i].items,&folders[i]);
-
-        folders[i].doWePrint = true;
+        return NULL;
     }
-
+    return colorForFile(item->name,strlen(item->name),item->itemStat.st_mode,item->linkTargetMode);
 }
 
 void trimTime(char* timeString, char* outputString){
@@ -351,43 +98,42 @@ void trimTime(char* timeString, char* outputString){
     }
 }
 
-int sortByName(const void* name1, const void* name2){
-    return strcmp( ((itemInDir*) name1)->name,((itemInDir*) name2)->name);
-}
-
-int sortFoldersByName(const void* name1, const void* name2){
-    return strcmp( ((itemInDir*) name1)->name,((itemInDir*) name2)->name);
-}
-
-int sortBySize(const void* item1, const void* item2){
-    return ((itemInDir*) item1)->itemStat.st_size < ((itemInDir*) item2)->itemStat.st_size;
-}
-
-//sort by modified time
-int sortByMtime(const void* item1, const void* item2){
-    return ((itemInDir*) item1)->itemStat.st_mtime < ((itemInDir*) item2)->itemStat.st_mtime;
-}
-
-//sort by access time
-int sortByAtime(const void* item1, const void* item2){
-                                                // <= makes this comparison actually correct
-    return ((itemInDir*) item1)->itemStat.st_atime <= ((itemInDir*) item2)->itemStat.st_atime;
-}
-
-//sort by status change time
-int sortByCtime(const void* item1, const void* item2){
-                                                // <= makes this comparison actually correct
-    return ((itemInDir*) item1)->itemStat.st_ctime < ((itemInDir*) item2)->itemStat.st_ctime;
-}
+//formatted times, by minute. The printed time only has minutes in it, and a directory
+//usually has lots of files from the same few minutes. Shared between server requests
+#define TIME_CACHE_SIZE 64
+static struct {
+    long long minute;
+    bool used;
+    char text[13];
+} timeCache[TIME_CACHE_SIZE];
+static pthread_mutex_t timeCacheLock = PTHREAD_MUTEX_INITIALIZER;
 
 /**
- * @brief Using the folder structs and the flags, sort the folder structs according to the flags
- * @param folders: lsRequestedItem structs to be sorted
- * @param flags: processed argv input flags
+ * @brief Formats a timestamp for the long listing, like "Oct 19 15:49"
+ * @param when: The timestamp
+ * @param outputString: At least 13 chars. Gets the null terminated time
  */
-void sortOutput(lsRequestedItem* folders, char* const flags){
-    // printf("Flags: %s\n",flags);
-    qsort((folders)->items,(folders)->itemCount,sizeof(itemInDir),sortByName);
+void formatTime(time_t when, char* outputString){
+    long long minute = when >= 0 ? when/60 : (when-59)/60;
+    int slot = (int)(((minute % TIME_CACHE_SIZE) + TIME_CACHE_SIZE) % TIME_CACHE_SIZE);
+    pthread_mutex_lock(&timeCacheLock);
+    if(timeCache[slot].used && timeCache[slot].minute == minute){
+        memcpy(outputString,timeCache[slot].text,13);
+        pthread_mutex_unlock(&timeCacheLock);
+        return;
+    }
+    pthread_mutex_unlock(&timeCacheLock);
+
+    char timeString[26];
+    ctime_r(&when,timeString);
+    trimTime(timeString,outputString);
+    outputString[12] = '\0';
+
+    pthread_mutex_lock(&timeCacheLock);
+    timeCache[slot].minute = minute;
+    timeCache[slot].used = true;
+    memcpy(timeCache[slot].text,outputString,13);
+    pthread_mutex_unlock(&timeCacheLock);
 }
 
 //used for sorting names for table printing
@@ -396,17 +142,61 @@ int sortNames(const void* name1, const void* name2){
 }
 
 int sortLengths(const void* item1, const void* item2){
-    return ((itemInDir*) item1)->nameLength < ((itemInDir*) item2)->nameLength;
+    return ((lsItem*) item1)->nameLength < ((lsItem*) item2)->nameLength;
 }
 
 
 
-//table printing
-void createPrintConfig(itemInDir* items, int numItems, int* finalRowCount, int* finalColCount){
-    //handling terminal width
-    struct winsize w;
-    ioctl(STDOUT_FILENO,TIOCGWINSZ,&w);
-    int cols = w.ws_col - 2;        //usable width
+/**
+ * @brief Counts how many digits are in the input number
+ * @param num: The input number that the number of digits will be calculated for
+ */
+int countDigits(int num){
+    if(num == 0){
+        return 1;
+    }
+    int digits = 1;
+    int num1 = abs(num);
+    while((num1 /= 10)>0){
+        digits++;
+    }
+    //add a digit for a negatve number (sentinel value)
+    if(num<0){
+        // digits++;
+    }
+    return digits;
+}
+
+/**
+ * @brief Works out the long listing column widths of one folder
+ * @param listing: The folder from the library
+ * @param widths: Set to the widest hard link count, owner, group, size and context in the folder
+ */
+void measureFolder(const lsRequestedItem* listing, widthInfo* widths){
+    memset(widths,0,sizeof(widthInfo));
+    for(int i = 0; i < listing->itemCount; i++){
+        const lsItem* item = &listing->items[i];
+        //the columns only exist if the library filled in the long listing info
+        if(item->lstatSuccessful == false || item->permissions == NULL){
+            continue;
+        }
+        keepMax(widths->hardLinksWidth,countDigits(item->hardLinksCount));
+        keepMax(widths->ownerWidth,strnlen(item->owner,256));
+        keepMax(widths->groupWidth,strnlen(item->group,256));
+        keepMax(widths->sizeWidth,countDigits(item->itemStat.st_size));
+        int contextWidth = item->context != NULL ? (int)strlen(item->context) : 1;    //"?" if there is none
+        keepMax(widths->contextWidth,contextWidth);
+    }
+}
+
+//table printing. padding gets the spaces printed after each name, numItems of them
+void createPrintConfig(lsItem* items, int numItems, int terminalWidth, int* padding, int* finalRowCount, int* finalColCount){
+    int cols = terminalWidth - 2;        //usable width
+    if(numItems == 0){
+        *finalColCount = 0;
+        *finalRowCount = 0;
+        return;
+    }
 
     int colCount = 1;  //items across
     int rowCount = numItems; //items down (in that column)
@@ -427,25 +217,26 @@ void createPrintConfig(itemInDir* items, int numItems, int* finalRowCount, int*
                 if(col*rowCount+row >= numItems){
                     break;
                 }
-                keepMax(maxWidth, strlen(items[col*rowCount+row].name));
+                keepMax(maxWidth, items[col*rowCount+row].nameLength);
             }
             //set width padding for each column
             for(int row = 0; row < rowCount; row++){
                 if(col*rowCount+row >= numItems){
                     break;
                 }
-                items[col*rowCount+row].nameWidthPadding = maxWidth - strlen(items[col*rowCount+row].name) + 2;
+                padding[col*rowCount+row] = maxWidth - items[col*rowCount+row].nameLength + 2;
             }
         }
         //check the total width of one row created by the total widths for all the columns
         usedWidth = -2;
         for(int i = 0; i < colCount; i++){
-            usedWidth += items[min(i*rowCount,numItems-1)].nameWidthPadding + strlen(items[min(i*rowCount,numItems-1)].name);
+            usedWidth += padding[min(i*rowCount,numItems-1)] + items[min(i*rowCount,numItems-1)].nameLength;
         }
         //if the width created is greater than the max width, take away one column. Remake the previous configuration
         if(usedWidth > cols){
             foundConfiguration = true;
-            configCols = colCount - 1;
+            //a name wider than the terminal overflows even one column. It still gets a column of its own
+            configCols = colCount > 1 ? colCount - 1 : 1;
             configRows = (int)ceil((float)numItems/configCols);
             //set final width padding
             maxWidth = 0;
@@ -456,14 +247,14 @@ void createPrintConfig(itemInDir* items, int numItems, int* finalRowCount, int*
                     if(col*configRows+row >= numItems){
                         break;
                     }
-                    keepMax(maxWidth, strlen(items[col*configRows+row].name));
+                    keepMax(maxWidth, items[col*configRows+row].nameLength);
                 }
                 //set final width padding for each column
                 for(int row = 0; row < configRows; row++){
                     if(col*configRows+row >= numItems){
                         break;
                     }
-                    items[col*configRows+row].nameWidthPadding = maxWidth - strlen(items[col*configRows+row].name) + 2;
+                    padding[col*configRows+row] = maxWidth - items[col*configRows+row].nameLength + 2;
                 }
             }
             break;
@@ -486,225 +277,271 @@ void createPrintConfig(itemInDir* items, int numItems, int* finalRowCount, int*
     *finalRowCount = configRows;
 }
 
-/**
- * @brief called when -l flag is specified. Print using long list format
- * @param printableFolders: lsRequestedItem structs that we actually print
- * @param startIndex: for for loop, used for if -r flag is specified
- * @param step: 1 or -1 depending on if printing order is reversed (-r)
- * @param i: index into which of the printable folders we are printing
- */
-void longFormatPrint(lsRequestedItem* printableFolders, int startIndex, int step, int numItems, int i){
-    for(int j = startIndex; step == -1 ? j >= 0 : j < numItems; j += step){
-        char* timeString = calloc(13,sizeof(char));
-        if(printableFolders[i].items[j].lstatSuccessful == false){
-            strncpy(timeString,"           ?",13);
-        }
-        else{
-            trimTime(ctime(&printableFolders[i].items[j].itemStat.st_mtime),timeString);
-        }
+//permissions, hard links, owner, group, (-Z) context, size and time of one entry whose lstat() worked.
+//context is a constant in every caller, so it is folded away once this is inlined
+static inline void printLongFields(FILE* out, const printedFolder* folder, const lsItem* item, bool context){
+    char timeString[13];
+    formatTime(item->itemStat.st_mtime,timeString);
+    if(context){
+        fprintf(out,"%s %*d %*s %*s %-*s %*ld %s ",item->permissions,folder->widths.hardLinksWidth,item->hardLinksCount,
+            folder->widths.ownerWidth,item->owner,folder->widths.groupWidth,item->group,
+            folder->widths.contextWidth,item->context != NULL ? item->context : "?",
+            folder->widths.sizeWidth,(long)item->itemStat.st_size,timeString);
+    }
+    else {
+        fprintf(out,"%s %*d %*s %*s %*ld %s ",item->permissions,folder->widths.hardLinksWidth,item->hardLinksCount,
+            folder->widths.ownerWidth,item->owner,folder->widths.groupWidth,item->group,
+            folder->widths.sizeWidth,(long)item->itemStat.st_size,timeString);
+    }
+}
 
-        //permissions
-        printf("%s ",printableFolders[i].items[j].permissions);
-        //hard links count
-        if(printableFolders[i].items[j].hardLinksCount<0)
-            printf("? ");
-        else    
-            printf("%*d ", printableFolders[i].widths.hardLinksWidth,printableFolders[i].items[j].hardLinksCount);
-        //owner
-        if(strcmp(printableFolders[i].items[j].owner,"?")==0)
-            printf("?%*s ",printableFolders[i].widths.ownerWidth-1,"");
-        else
-            printf("%*s ",printableFolders[i].widths.ownerWidth,printableFolders[i].items[j].owner);
-        //group
-        if(strcmp(printableFolders[i].items[j].group,"?")==0)
-            printf("?%*s ",printableFolders[i].widths.groupWidth-1,"");
-        else
-            printf("%*s ",printableFolders[i].widths.groupWidth,printableFolders[i].items[j].group);
-        //size
-        if(printableFolders[i].items[j].itemStat.st_size == SENTINEL)
-            printf("%*s ", printableFolders[i].widths.sizeWidth,"?");
-        else
-            printf("%*ld ", printableFolders[i].widths.sizeWidth,printableFolders[i].items[j].itemStat.st_size);
-        //time
-        printf("%s ", timeString);
-        //name
-        //if dir
-        if(printableFolders[i].items[j].isDir == true){
-            printf("%s%s%s",BLUE,printableFolders[i].items[j].name,DEFAULT);
-        }
-        //if link
-        else if(printableFolders[i].items[j].isLink == true){
-            printf("%s%s%s -> ",CYAN,printableFolders[i].items[j].name,DEFAULT);
-            if(printableFolders[i].items[j].pointsToDir == true){
-                printf("%s%s%s",BLUE,printableFolders[i].items[j].link,DEFAULT);
-            }
-            else{
-                printf("%s",printableFolders[i].items[j].link);
-            }
-        }
-        //if neither dir nor link, print default
-        else {
-            printf("%s",printableFolders[i].items[j].name);
-        }
-        
-        if(step == -1 && j>0){
-            printf("\n");
-        }
-        else if(step == 1 && j<numItems-1){
-            printf("\n");
-        }
+//the same fields for an entry whose lstat() failed. Everything but the name is ?
+static inline void printUnknownFields(FILE* out, const printedFolder* folder, const lsItem* item, bool context){
+    fprintf(out,"%s ? ?%*s ?%*s ",item->permissions,folder->widths.ownerWidth-1,"",folder->widths.groupWidth-1,"");
+    if(context){
+        fprintf(out,"%-*s ",folder->widths.contextWidth,"?");
+    }
+    fprintf(out,"%*s            ? ",folder->widths.sizeWidth,"?");
+}
 
-        //cleanup
-        if(printableFolders[i].items[j].isLink){
-            free(printableFolders[i].items[j].link);
-        }
-        free(printableFolders[i].items[j].name);
-        free(printableFolders[i].items[j].path);
-        free(printableFolders[i].items[j].permissions);
-        free(timeString);
+/*
+    The printers below are stamped out once per output mode, so the loops over entries never check -l or
+    whether colors are on. COLOR is a literal 0 or 1, so the compiler drops the branch it is not taking.
+    choosePrinter() picks one per command.
+*/
+
+//print using long list format (-l, -n)
+#define LONG_PRINTER(NAME, COLOR, CONTEXT) \
+void NAME(FILE* out, const printedFolder* folder, int columns){ \
+    (void)columns; \
+    for(int j = 0; j < folder->listing->itemCount; j++){ \
+        lsItem* item = &folder->listing->items[j]; \
+        if(item->lstatSuccessful) \
+            printLongFields(out,folder,item,CONTEXT); \
+        else \
+            printUnknownFields(out,folder,item,CONTEXT); \
+        if(COLOR) \
+            printColored(out,item->name,itemColor(item)); \
+        else \
+            fputs(item->name,out); \
+        /*if link, also print where it points to*/ \
+        if(item->isLink){ \
+            fputs(" -> ",out); \
+            if(COLOR) \
+                printColored(out,item->link,colorForLinkTarget(item->link,strlen(item->link),item->linkTargetMode)); \
+            else \
+                fputs(item->link,out); \
+        } \
+        fputc('\n',out); \
+    } \
+}
+
+//print names in columns, filling each column top to bottom
+#define GRID_PRINTER(NAME, COLOR) \
+void NAME(FILE* out, const printedFolder* folder, int columns){ \
+    const lsRequestedItem* listing = folder->listing; \
+    int rowCount = 0, colCount = 0; \
+    int* padding = malloc((listing->itemCount+1)*sizeof(int)); \
+    createPrintConfig(listing->items,listing->itemCount,columns,padding,&rowCount,&colCount); \
+    for(int row = 0; row < rowCount; row++){ \
+        /*columns that have an entry in this row. Only the last column can be short*/ \
+        int used = (listing->itemCount - row + rowCount - 1)/rowCount; \
+        int padded = min(used,colCount-1); \
+        for(int col = 0; col < padded; col++){ \
+            lsItem* item = &listing->items[col*rowCount+row]; \
+            if(COLOR) \
+                printColored(out,item->name,itemColor(item)); \
+            else \
+                fputs(item->name,out); \
+            fprintf(out,"%*s",padding[col*rowCount+row],""); \
+        } \
+        if(used == colCount){ \
+            lsItem* item = &listing->items[(colCount-1)*rowCount+row]; \
+            if(COLOR) \
+                printColored(out,item->name,itemColor(item)); \
+            else \
+                fputs(item->name,out); \
+        } \
+        fputc('\n',out); \
+    } \
+    free(padding); \
+}
+
+LONG_PRINTER(printLongPlain, 0, 0)
+LONG_PRINTER(printLongColor, 1, 0)
+LONG_PRINTER(printLongPlainContext, 0, 1)   //-Z
+LONG_PRINTER(printLongColorContext, 1, 1)
+GRID_PRINTER(printGridPlain, 0)
+GRID_PRINTER(printGridColor, 1)
+
+/**
+ * @brief Picks the folder printer for a command. Call after initColors(), since colors are part of the choice
+ * @param command: Its printFolder is set
+ */
+void choosePrinter(lsCommand* command){
+    if(command->longFormat && command->options.securityContext){
+        command->printFolder = colorsEnabled() ? printLongColorContext : printLongPlainContext;
+    }
+    else if(command->longFormat){
+        command->printFolder = colorsEnabled() ? printLongColor : printLongPlain;
+    }
+    else {
+        command->printFolder = colorsEnabled() ? printGridColor : printGridPlain;
     }
 }
 
 /**
- * @brief Using the structs we populated earlier, print the information to the screen, coloring directories as blue.
+ * @brief Using the structs we populated earlier, print the information to the screen, coloring names using LS_COLORS.
+ * Frees the folders' items when done.
+ * @param out: Where the listing is written
+ * @param command: The parsed command line. Its printFolder prints each folder
  * @param argTargetCount: Number of directories passed in through argv
  * @param printTargetCount: Number of directories we can actually print
- * @param folders: The folder structs we filled in with ls() 
- * @param flags: The flags string. 
+ * @param folders: The folder structs we filled in with lsListTargets() 
 */
-void printLS(int argTargetCount, int printTargetCount, lsRequestedItem* folders, char* flags){
+void printLS(FILE* out, const lsCommand* command, int argTargetCount, int printTargetCount, lsRequestedItem* folders){
     //we only care about the folders we can actually print
-    lsRequestedItem* printableFolders = malloc(printTargetCount*sizeof(lsRequestedItem));
+    printedFolder* printableFolders = malloc(printTargetCount*sizeof(printedFolder));
     for(int i = 0, j = 0; i < argTargetCount;i ++){
-        //copy over folders we need to print, skipping ones we don't
-        if(folders[i].doWePrint){
-            memcpy(&printableFolders[j],&folders[i],sizeof(lsRequestedItem));
-            j++;
+        //skip the folders that could not be read
+        if(folders[i].error != 0){
+            continue;
         }
-    }
-
-    int startIndex = 0;
-    int step = 1;
-
-    //if no f flag, sort output (by name)
-    //if f flag is present, do not sort output
-    if(!fflag){
-        sortOutput(folders, flags);
-        for(int i = 0; i < printTargetCount; i++){
-            qsort(printableFolders[i].items,printableFolders[i].itemCount,sizeof(itemInDir),sortByName);
+        printableFolders[j].listing = &folders[i];
+        //if we pass more than one directory, list the path above the contents of that directory
+        printableFolders[j].header = NULL;
+        if(argTargetCount > 1){
+            printableFolders[j].header = command->shownTargets != NULL ? command->shownTargets[i] : command->targets[i];
         }
+        measureFolder(&folders[i],&printableFolders[j].widths);
+        j++;
     }
 
-
-
-    //print the structs
+    //print the structs. lsListTargets() already sorted them
     for(int i = 0; i < printTargetCount; i++){
-        int numItems = printableFolders[i].itemCount;
-        // //sort by size, highest size first
-
         //if we print more than one dir, we want the path listed above the contents
-        if(printableFolders[i].showPath){
+        if(printableFolders[i].header != NULL){
             //since newlines between dirs are structured as \n,header\n,contents\n, we don't print a newline at the start
             //since that would create an extra newline at the top of the printed dirs
             if(i != 0){
-                printf("\n");
-            }
-            printf("%s:\n",printableFolders[i].path);
-        }
-        if(Sflag){  //size
-            qsort(printableFolders[i].items,printableFolders[i].itemCount,sizeof(itemInDir),sortBySize);
-        }
-        if(tflag){  //modified time
-            qsort(printableFolders[i].items,printableFolders[i].itemCount,sizeof(itemInDir),sortByMtime);
-        }
-        if(uflag){  //access time
-            qsort(printableFolders[i].items,printableFolders[i].itemCount,sizeof(itemInDir),sortByAtime);
-        }
-        if(cflag){  //status change time
-            qsort(printableFolders[i].items,printableFolders[i].itemCount,sizeof(itemInDir),sortByCtime);
-        }
-        //go in reverse if -r flag is specified
-        if(rflag){
-            int left = 0, right = numItems - 1;
-            while(left < right){
-                itemInDir temp = printableFolders[i].items[left];
-                printableFolders[i].items[left] = printableFolders[i].items[right];
-                printableFolders[i].items[right] = temp;
-                left++;
-                right--;
-            }
-        }
-
-        //print each item in each printable folder, colorzing directories as blue
-        if(lflag || nflag){
-            printf("total %ld\n",printableFolders[i].totalBlocks);
-            longFormatPrint(printableFolders,startIndex,step,numItems,i);
-        }
-        //if not using long listing format
-        else {
-            int rowCount = 0, colCount = 0;
-            createPrintConfig(printableFolders[i].items,numItems,&rowCount,&colCount);
-            for(int row = 0; row < rowCount; row++){
-                for(int col = 0; col < colCount; col++){
-                    if(col*rowCount+row >= numItems){
-                        break;
-                    }
-                    if(printableFolders[i].items[col*rowCount+row].isDir == true){
-                        printf("%s%s%s",BLUE, printableFolders[i].items[col*rowCount+row].name, DEFAULT);
-                    }
-                    //check for link first because the "default" print case should be last
-                    else if(printableFolders[i].items[col*rowCount+row].isLink == true){
-                        printf("%s%s%s",CYAN, printableFolders[i].items[col*rowCount+row].name, DEFAULT);
-                    }
-                    else if(printableFolders[i].items[col*rowCount+row].isDir == false){
-                        printf("%s",printableFolders[i].items[col*rowCount+row].name);
-                    }
-                    if(col != colCount - 1){
-                        printf("%*s",printableFolders[i].items[col*rowCount+row].nameWidthPadding,"");
-                    }
-                    free(printableFolders[i].items[col*rowCount+row].name);
-                    free(printableFolders[i].items[col*rowCount+row].path);
-                    if(printableFolders[i].items[col*rowCount+row].isLink){
-                        free(printableFolders[i].items[col*rowCount+row].link);
-                    }
-                }
-                if(row < rowCount-1)
-                    puts("");
+                fprintf(out,"\n");
             }
+            fprintf(out,"%s:\n",printableFolders[i].header);
         }
-        //don't print a blank line for folders with no items
-        if(numItems>0){
-            printf("\n");
+        if(command->longFormat){
+            fprintf(out,"total %ld\n",printableFolders[i].listing->totalBlocks);
         }
+        command->printFolder(out,&printableFolders[i],command->columns);
     }
 
     //Cleanup
     for(int i = 0;i < argTargetCount; i++){
-        if(folders[i].showPath){
-            free(folders[i].path);
-        }
-        free(folders[i].items);
+        lsFreeDir(&folders[i]);
     }
     free(printableFolders);
 }
 
-int main(int argc, char* argv[]){
-    char** lsTargets = malloc((argc+1)*sizeof(*lsTargets));
-
-    //gonna change argument handling to getopt() eventually
-
-    char flags[1024] = {'0'};
+/**
+ * @brief Parses a whole number that has to be at least 1, like a thread count or a terminal width
+ * @param text: The number. Nothing but digits is accepted
+ * @param value: Set to the number
+ * @returns false if text is not a number, is less than 1, or doesn't fit in an int
+ */
+bool parsePositiveInt(const char* text, int* value){
+    char* end;
+    errno = 0;
+    long number = strtol(text,&end,10);
+    if(errno != 0 || end == text || *end != '\0' || !isdigit((unsigned char)text[0]) || number < 1 || number > INT_MAX){
+        return false;
+    }
+    *value = (int)number;
+    return true;
+}
 
-    int flagCount = 0;
-    int argTargetCount = 0;       //number of lsTargets passed in through argv
-    int printTargetCount = 0;     //number of lsTargets that we can actually print
+/**
+ * @brief Parses a command line into an lsCommand. Can be called more than once (the server parses every request with it),
+ * but not from two threads at the same time, since getopt keeps global state.
+ * @param argc: number of arguments
+ * @param argv: the arguments, argv[0] is the program name. getopt may reorder them
+ * @param command: Filled in by the function. Free with freeCommand(), even if parsing fails
+ * @param err: Where to write errors about bad arguments
+ * @returns 0, or 2 if the arguments are not valid
+ */
+int parseArgs(int argc, char** argv, lsCommand* command, FILE* err){
+    //position of each flag on the command line, 0 if it was not given
+    int Aflag = 0, aflag = 0, lflag = 0, rflag = 0, fflag = 0, nflag = 0, Sflag = 0, cflag = 0, tflag = 0, uflag = 0;
+    int atFlag = 0, Zflag = 0;
+
+    memset(command,0,sizeof(lsCommand));
+    command->columns = 80;
+    command->serverThreads = 4;
+    command->targets = malloc((argc+1)*sizeof(*command->targets));
+    lsOptions* options = &command->options;      //flags that change what gets listed, handed to the scanning library
+    lsFilterSet* filters = &options->filters;
+
+    //long options that have no short form
+    enum {
+        OPT_INCLUDE = 256,
+        OPT_MIN_SIZE,
+        OPT_MAX_SIZE,
+        OPT_NEWER,
+        OPT_OLDER,
+        OPT_OFFSET,
+        OPT_LIMIT,
+        OPT_CURSOR,
+        OPT_SNAPSHOT,
+        OPT_DIFF,
+        OPT_SERVER,
+        OPT_THREADS,
+        OPT_CONNECT,
+        OPT_BINARY
+    };
+    static struct option longOptions[] = {
+        {"include", required_argument, NULL, OPT_INCLUDE},
+        {"exclude", required_argument, NULL, 'I'},
+        {"ignore", required_argument, NULL, 'I'},
+        {"min-size", required_argument, NULL, OPT_MIN_SIZE},
+        {"max-size", required_argument, NULL, OPT_MAX_SIZE},
+        {"newer", required_argument, NULL, OPT_NEWER},
+        {"older", required_argument, NULL, OPT_OLDER},
+        {"offset", required_argument, NULL, OPT_OFFSET},
+        {"limit", required_argument, NULL, OPT_LIMIT},
+        {"cursor", required_argument, NULL, OPT_CURSOR},
+        {"snapshot", required_argument, NULL, OPT_SNAPSHOT},
+        {"diff", required_argument, NULL, OPT_DIFF},
+        {"server", required_argument, NULL, OPT_SERVER},
+        {"threads", required_argument, NULL, OPT_THREADS},
+        {"connect", required_argument, NULL, OPT_CONNECT},
+        {"binary", no_argument, NULL, OPT_BINARY},
+        {NULL, 0, NULL, 0}
+    };
+    time_t now = time(NULL);
 
     int opt;
     //used to get order/position of argument
     int counter = 0;
-    while((opt = getopt(argc, argv, "AalrfnScdFhikqRstuw")) != -1){
+    optind = 0;     //start over, in case argv was parsed before
+    opterr = 0;     //bad options are reported to err below, which is the client's for a server request
+    //the leading : makes a missing argument come back as ':' instead of '?'
+    while((opt = getopt_long(argc, argv, ":AalrfnScdFhikqRstuwI:@Z", longOptions, NULL)) != -1){
         counter++;
         switch(opt){
+            case '?':
+                if(optopt != 0){
+                    fprintf(err,"ls: invalid option -- '%c'\n",optopt);
+                }
+                else {
+                    fprintf(err,"ls: unrecognized option '%s'\n",argv[optind-1]);
+                }
+                return 2;
+            case ':':
+                if(optopt < 256){
+                    fprintf(err,"ls: option requires an argument -- '%c'\n",optopt);
+                }
+                else {
+                    fprintf(err,"ls: option '%s' requires an argument\n",argv[optind-1]);
+                }
+                return 2;
             case 'A':
                 Aflag = counter;
                 break;
@@ -723,65 +560,348 @@ int main(int argc, char* argv[]){
             case 'n':
                 nflag = counter;
                 break;
+            case '@':
+                atFlag = counter;
+                break;
+            case 'Z':
+                Zflag = counter;
+                break;
             case 'S':
                 Sflag = counter;
                 break;
             case 'c':
                 cflag = counter;
                 break;
-            case 'd':
-                dflag = counter;
+            case 't':
+                tflag = counter;
                 break;
-            case 'F':
-                Fflag = counter;
+            case 'u':
+                uflag = counter;
                 break;
+            case 'd':
+            case 'F':
             case 'h':
-                hflag = counter;
-                break;
             case 'i':
-                iflag = counter;
-                break;
             case 'k':
-                kflag = counter;
-                break;
             case 'q':
-                qflag = counter;
-                break;
             case 'R':
-                Rflag = counter;
-                break;
             case 's':
-                sflag = counter;
+            case 'w':
+                //accepted, but not implemented yet
                 break;
-            case 't':
-                tflag = counter;
+            case 'I':
+                lsAddNamePattern(filters,optarg,false);
                 break;
-            case 'u':
-                uflag = counter;
+            case OPT_INCLUDE:
+                lsAddNamePattern(filters,optarg,true);
                 break;
-            case 'w':
-                wflag = counter;
+            case OPT_MIN_SIZE:
+            case OPT_MAX_SIZE:
+                if(!lsParseSize(optarg,opt == OPT_MIN_SIZE ? &filters->minSize : &filters->maxSize)){
+                    fprintf(err,"ls: invalid size '%s'\n",optarg);
+                    return 2;
+                }
+                if(opt == OPT_MIN_SIZE)
+                    filters->hasMinSize = true;
+                else
+                    filters->hasMaxSize = true;
+                break;
+            case OPT_NEWER:
+            case OPT_OLDER:
+                if(!lsParseAge(optarg,now,opt == OPT_NEWER ? &filters->newerThan : &filters->olderThan)){
+                    fprintf(err,"ls: invalid age '%s'\n",optarg);
+                    return 2;
+                }
+                if(opt == OPT_NEWER)
+                    filters->hasNewer = true;
+                else
+                    filters->hasOlder = true;
+                break;
+            case OPT_OFFSET:
+            case OPT_LIMIT: {
+                char* end;
+                errno = 0;
+                unsigned long long count = strtoull(optarg,&end,10);
+                if(errno != 0 || end == optarg || *end != '\0' || optarg[0] == '-'){
+                    fprintf(err,"ls: invalid %s '%s'\n",opt == OPT_OFFSET ? "offset" : "limit",optarg);
+                    return 2;
+                }
+                if(opt == OPT_OFFSET)
+                    options->offset = count;
+                else
+                    options->limit = count;
+                break;
+            }
+            case OPT_CURSOR:
+                if(!lsParseCursor(optarg,&options->cursor)){
+                    fprintf(err,"ls: invalid cursor '%s'\n",optarg);
+                    return 2;
+                }
+                options->hasCursor = true;
+                break;
+            case OPT_SNAPSHOT:
+                free(command->snapshotPath);
+                command->snapshotPath = strdup(optarg);
+                break;
+            case OPT_DIFF:
+                free(command->diffPath);
+                command->diffPath = strdup(optarg);
+                break;
+            case OPT_SERVER:
+                command->serverPath = optarg;
+                break;
+            case OPT_THREADS:
+                if(!parsePositiveInt(optarg,&command->serverThreads)){
+                    fprintf(err,"ls: invalid thread count '%s'\n",optarg);
+                    return 2;
+                }
+                break;
+            case OPT_CONNECT:
+                command->connectPath = optarg;
+                break;
+            case OPT_BINARY:
+                command->binary = true;
                 break;
         }
 
     }
-    
-    getFlagsAndDirs(argc,argv,flags,lsTargets,&flagCount,&argTargetCount);
+    //--newer and --older look at the same timestamp as -t sorting
+    if(uflag){
+        filters->timeField = LS_TIME_ATIME;
+    }
+    else if(cflag){
+        filters->timeField = LS_TIME_CTIME;
+    }
+    //the last of -A and -a wins
+    if(Aflag != 0 && Aflag > aflag){
+        options->hidden = LS_SHOW_ALMOST_ALL;
+    }
+    else if(aflag || Aflag || fflag){
+        options->hidden = LS_SHOW_ALL;
+    }
+    //-c takes priority over -u, then -t, then -S
+    if(cflag){
+        options->sortKey = LS_SORT_CTIME;
+    }
+    else if(uflag){
+        options->sortKey = LS_SORT_ATIME;
+    }
+    else if(tflag){
+        options->sortKey = LS_SORT_MTIME;
+    }
+    else if(Sflag){
+        options->sortKey = LS_SORT_SIZE;
+    }
+    options->unsorted = fflag != 0;
+    options->reverse = rflag != 0;
+    options->numericIds = nflag != 0;
+    command->longFormat = lflag || nflag;
+    //names, permissions and attributes are only looked up when they get printed
+    options->longInfo = command->longFormat || command->binary;
+    options->xattrIndicator = atFlag && command->longFormat;
+    options->securityContext = Zflag && command->longFormat;
+
+    //getopt moves everything that is not an option (or an option argument) to the end of argv
+    for(int i = optind; i < argc; i++){
+        command->targets[command->targetCount] = strndup(argv[i],1024);
+        command->targetCount++;
+    }
     //run ls on the current dirctory if we don't provide any directory arguments
-    if(argTargetCount<1){
-        lsTargets[0] = malloc(2); //"."
-        memcpy(lsTargets[0],".",2);
-        argTargetCount = 1;
-    }
-    //allocate space in case we need to print all the lsTargets.
-    lsRequestedItem* folders = malloc(argTargetCount*sizeof(lsRequestedItem));
-    ls(flags,argTargetCount,&printTargetCount,lsTargets,folders);
-    printLS(argTargetCount,printTargetCount,folders,flags);
+    if(command->targetCount<1){
+        command->targets[0] = malloc(2); //"."
+        memcpy(command->targets[0],".",2);
+        command->targetCount = 1;
+    }
+    //offset+limit is how many entries a sorted page keeps
+    if(options->limit > SIZE_MAX - options->offset){
+        fprintf(err,"ls: --offset and --limit are too large together\n");
+        return 2;
+    }
+    //a cursor is a position in one directory's stream, which only -f reads in order
+    if(options->hasCursor && (!options->unsorted || options->sortKey != LS_SORT_NAME || command->targetCount != 1)){
+        fprintf(err,"ls: --cursor only works with -f and one directory\n");
+        return 2;
+    }
+    if(command->snapshotPath != NULL && command->diffPath != NULL){
+        fprintf(err,"ls: --snapshot and --diff can't be used together\n");
+        return 2;
+    }
+    choosePrinter(command);
+    return 0;
+}
+
+//frees everything parseArgs() allocated
+void freeCommand(lsCommand* command){
+    for(int i = 0; i < command->targetCount; i++){
+        free(command->targets[i]);
+        if(command->shownTargets != NULL){
+            free(command->shownTargets[i]);
+        }
+    }
+    free(command->targets);
+    free(command->shownTargets);
+    free(command->snapshotPath);
+    free(command->diffPath);
+    lsFreeFilters(&command->options.filters);
+}
+
+//where --diff prints to, and how many differences it found
+typedef struct diffOutput {
+    FILE* out;
+    int count;
+} diffOutput;
+
+//prints one line of --diff output
+int printDifference(lsSnapshotChange change, const char* dir, const char* name, unsigned changed, void* context){
+    static const char* fieldNames[] = {"type", "mode", "size", "mtime", "owner", "inode", "link", "links"};
+    diffOutput* output = context;
+    size_t dirLen = strlen(dir);
+    fprintf(output->out,"%c %s%s%s",change,dir,dirLen > 0 && dir[dirLen-1] == '/' ? "" : "/",name);
+    const char* separator = " (";
+    for(size_t i = 0; i < sizeof(fieldNames)/sizeof(fieldNames[0]); i++){
+        if(changed & (1u << i)){
+            fprintf(output->out,"%s%s",separator,fieldNames[i]);
+            separator = ", ";
+        }
+    }
+    fprintf(output->out,changed != 0 ? ")\n" : "\n");
+    output->count++;
+    return 0;
+}
+
+/**
+ * @brief Compares a snapshot with the directories as they are now, for --diff
+ * @returns exit status: 0 if nothing changed, 1 if something did, 2 if the snapshot could not be read
+ */
+int runDiff(lsCommand* command, FILE* out, FILE* err){
+    FILE* in = fopen(command->diffPath,"rb");
+    if(in == NULL){
+        fprintf(err,"ls: cannot open '%s': %s\n",command->diffPath,strerror(errno));
+        return 2;
+    }
+    diffOutput output = {out, 0};
+    int error = lsSnapshotDiff(in,&command->options,printDifference,&output);
+    fclose(in);
+    if(error == EINVAL){
+        fprintf(err,"ls: '%s' is not a valid snapshot\n",command->diffPath);
+        return 2;
+    }
+    if(error != 0){
+        fprintf(err,"ls: cannot diff '%s': %s\n",command->diffPath,strerror(error));
+        return 2;
+    }
+    return output.count > 0 ? 1 : 0;
+}
+
+/**
+ * @brief Lists everything a command asks for
+ * @param command: The parsed command line
+ * @param out: Where the listing is written
+ * @param err: Where errors are written
+ * @returns exit status
+ */
+int runCommand(lsCommand* command, FILE* out, FILE* err){
+    if(command->diffPath != NULL){
+        return runDiff(command,out,err);
+    }
+    if(command->snapshotPath != NULL){
+        lsSnapshotOrder(&command->options);
+    }
+    int printTargetCount = 0;     //number of targets that we can actually print
+    //allocate space in case we need to print all the targets.
+    lsRequestedItem* folders = malloc(command->targetCount*sizeof(lsRequestedItem));
+    lsListTargets(&command->options,command->targetCount,&printTargetCount,command->targets,folders);
+    //the library doesn't print, so report what could not be read before printing the listings
+    for(int i = 0; i < command->targetCount; i++){
+        const char* shown = command->shownTargets != NULL ? command->shownTargets[i] : command->targets[i];
+        if(folders[i].error != 0){
+            fprintf(err,"ls: cannot access '%s': %s",shown,strerror(folders[i].error));
+            //only a text listing has room for the line break. Records and snapshots end the message on err
+            fprintf(command->binary || command->snapshotPath != NULL ? err : out,"\n");
+            continue;
+        }
+        for(int j = 0; folders[i].statErrorCount > 0 && j < folders[i].itemCount; j++){
+            if(folders[i].items[j].lstatSuccessful == false){
+                fprintf(err,"Error: lstat(%s) failed: %s\n",folders[i].items[j].path,strerror(folders[i].items[j].lstatErrno));
+            }
+        }
+        if(folders[i].hasNextCursor && !command->binary){
+            char cursor[LS_CURSOR_MAX];
+            lsFormatCursor(&folders[i].nextCursor,cursor);
+            fprintf(err,"ls: next cursor: %s\n",cursor);
+        }
+    }
+    int status = 0;
+    if(command->snapshotPath != NULL){
+        FILE* snapshot = fopen(command->snapshotPath,"wb");
+        if(snapshot == NULL){
+            fprintf(err,"ls: cannot create '%s': %s\n",command->snapshotPath,strerror(errno));
+            status = 2;
+        }
+        else {
+            //paths are saved as given, --diff scans them again from wherever it is run
+            lsSnapshotWrite(snapshot,folders,command->targetCount,command->targets);
+            if(fclose(snapshot) != 0){
+                fprintf(err,"ls: cannot write '%s': %s\n",command->snapshotPath,strerror(errno));
+                status = 2;
+            }
+        }
+        for(int i = 0; i < command->targetCount; i++){
+            lsFreeDir(&folders[i]);
+        }
+    }
+    else if(command->binary){
+        writeRecords(out,folders,command->targetCount,command->shownTargets != NULL ? command->shownTargets : command->targets);
+        for(int i = 0; i < command->targetCount; i++){
+            lsFreeDir(&folders[i]);
+        }
+    }
+    else {
+        printLS(out,command,command->targetCount,printTargetCount,folders);
+    }
     free(folders);
+    return status;
+}
 
-    //cleanup (kinda)
-    for(int i = 0; i < argc; i++){
-        free(lsTargets[i]);
+//width of the terminal stdout is going to, or 80 if it is not a terminal
+int terminalWidth(void){
+    struct winsize w;
+    if(ioctl(STDOUT_FILENO,TIOCGWINSZ,&w) == 0 && w.ws_col > 0){
+        return w.ws_col;
     }
-    free(lsTargets);
-}
\ No newline at end of file
+    return 80;
+}
+
+int main(int argc, char* argv[]){
+    //--connect sends the command line as it was typed, so keep a copy before getopt reorders argv
+    char** originalArgs = malloc((argc+1)*sizeof(*originalArgs));
+    memcpy(originalArgs,argv,(argc+1)*sizeof(*originalArgs));
+
+    lsCommand command;
+    int status = parseArgs(argc,argv,&command,stderr);
+    if(status != 0){
+        //nothing to do
+    }
+    else if(command.serverPath != NULL && command.connectPath != NULL){
+        fprintf(stderr,"ls: --server and --connect can't be used together\n");
+        status = 2;
+    }
+    else if(command.serverPath != NULL){
+        status = runServer(command.serverPath,command.serverThreads);
+    }
+    else if(command.connectPath != NULL){
+        status = runClient(command.connectPath,terminalWidth(),argc,originalArgs);
+    }
+    else {
+        //LS_COLORS is parsed once here, before any names are printed
+        initColors();
+        choosePrinter(&command);
+        command.columns = terminalWidth();
+        status = runCommand(&command,stdout,stderr);
+    }
+
+    //cleanup (kinda)
+    freeCommand(&command);
+    free(originalArgs);
+    return status;
+}
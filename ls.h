@@ -1,20 +1,16 @@
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
 #include <sys/stat.h>
+#include "lsscan.h"
+#include "server.h"
+#include "snapshot.h"
 
-#define BLUE "\x1b[34;1m"
-#define DEFAULT "\x1b[0m"
-#define GREEN "\x1b[32;1m"
-#define CYAN "\x1b[36;1m"
-
-#define SENTINEL -1
 #define max(a,b) a < b ? b : a
 #define min(a,b) a > b ? b : a
 #define keepMax(a,b) a < b ? a=b : a    //set a to b if b > a
 
-int Aflag = 0, aflag = 0, lflag = 0, rflag = 0, fflag = 0, nflag = 0, Sflag = 0, cflag = 0, dflag = 0, Fflag = 0, hflag = 0, iflag = 0, kflag = 0;
-int qflag = 0, Rflag = 0, sflag = 0, tflag = 0, uflag = 0, wflag = 0;
-
 //maximum widths for each attribute
 typedef struct widthInfo {
     //int permissionsWidth;
@@ -22,47 +18,37 @@ typedef struct widthInfo {
     int ownerWidth;
     int groupWidth;
     int sizeWidth;
+    int contextWidth;
     //int timeWidth;
     int nameWidth;      //used for pretty table printing
 } widthInfo;
 
-//these will be populated with information from ls(), and then sorted and printed
-
-//Contains information about each file in a directory
-typedef struct itemInDir {
-    char* name;     //name of the file itself
-    char* path;     //path to file - used for stat()
-    int nameLength; //length of file name
-    bool isDir;     //Used for colorization
-
-    struct stat itemStat;   //stat information for each file in a directory
-
-    char* fileType; //?
-    char* permissions;  //permissions of the file
-    int hardLinksCount;
-    char* owner;
-    char* group;
-    ssize_t size;    //file size
-    long mtime;    //modified time
-    bool lstatSuccessful;
-    char* link;     //where the link points to if the file is a link
-    bool pointsToDir;   //if the file is a link, then does the file point to a directory?
-    bool isLink;
-    int nameWidthPadding;
-
-} itemInDir;        //each item in a directory
-
-//information about one ls target we are reading
-typedef struct lsRequestedItem {
-    bool showPath;     //If printing the directory path above the contents
-    char* path;         //Absolute path to the folder
-    itemInDir* items;   //array of item info structures for that directory
-    int itemCount;      //number of items in directory
-    bool doWePrint;     //do we print the contents of this folder?
-    size_t totalBlocks;   //for -l, shows sum of size of all the items in the directory
-    widthInfo widths;     //width information for each directory
-    struct stat targetStat;   //stat information for this directory
-} lsRequestedItem;           //one folder read by ls
+//one folder as it gets printed: the listing from the library, and the layout worked out for it here
+typedef struct printedFolder {
+    lsRequestedItem* listing;
+    const char* header;     //printed above the contents when more than one directory is listed, NULL otherwise
+    widthInfo widths;       //long listing columns
+} printedFolder;
+
+//prints the entries of one folder in one output mode, see choosePrinter()
+typedef void (*folderPrinter)(FILE* out, const printedFolder* folder, int columns);
+
+//what one run of ls was asked to do, parsed from the command line
+typedef struct lsCommand {
+    lsOptions options;      //handed to the scanning library
+    bool longFormat;        //-l or -n
+    int columns;            //terminal width, used for the grid
+    folderPrinter printFolder;  //picked once from -l and colors, so printing doesn't check them per entry
+    char** targets;         //directories to list
+    char** shownTargets;    //if not NULL, how the targets are printed. The server uses this for relative paths
+    int targetCount;
+    bool binary;            //--binary
+    char* snapshotPath;     //--snapshot: write a snapshot file instead of printing
+    char* diffPath;         //--diff: compare a snapshot file with the directories now
+    char* serverPath;       //--server
+    int serverThreads;      //--threads
+    char* connectPath;      //--connect
+} lsCommand;
 
 // typedef struct printConfigTable {
 
@@ -76,20 +62,44 @@ typedef struct nameAndLen {
 
 int argSortComp(const void* argA, const void* argB);
 
+const char* itemColor(lsItem* item);
+
+void trimTime(char* timeString, char* outputString);
+
+void formatTime(time_t when, char* outputString);
+
 int countDigits(int num);
 
-void getFlagsAndDirs(int argc, char** const inputArgs, char* outputFlags, char** outputTargets, int* flagCount, int* argDirCount);
+void measureFolder(const lsRequestedItem* listing, widthInfo* widths);
 
-void getLinkInfo(itemInDir* item, struct stat fileStat, bool secondCall);
+void createPrintConfig(lsItem* items, int numItems, int terminalWidth, int* padding, int* finalRowCount, int* finalColCount);
 
-void getLongListInfo(itemInDir* item, lsRequestedItem* folder, char* flags);
+void printLS(FILE* out, const lsCommand* command, int argDirCount, int printDirCount, lsRequestedItem* folders);
 
-int whichItems(char* const dir, char* const flags, itemInDir* outputItems, lsRequestedItem* folder);
+void printLongPlain(FILE* out, const printedFolder* folder, int columns);
 
-void ls(char* const flags, int argDirCount, int* printDirCount, char** const dirs, lsRequestedItem* folders);
+void printLongColor(FILE* out, const printedFolder* folder, int columns);
 
-void trimTime(char* timeString, char* outputString);
+void printLongPlainContext(FILE* out, const printedFolder* folder, int columns);
+
+void printLongColorContext(FILE* out, const printedFolder* folder, int columns);
+
+void printGridPlain(FILE* out, const printedFolder* folder, int columns);
+
+void printGridColor(FILE* out, const printedFolder* folder, int columns);
+
+void choosePrinter(lsCommand* command);
+
+bool parsePositiveInt(const char* text, int* value);
+
+int parseArgs(int argc, char** argv, lsCommand* command, FILE* err);
+
+void freeCommand(lsCommand* command);
+
+int printDifference(lsSnapshotChange change, const char* dir, const char* name, unsigned changed, void* context);
+
+int runDiff(lsCommand* command, FILE* out, FILE* err);
 
-void printLS(int argDirCount, int printDirCount, lsRequestedItem* folders, char* flags);
+int runCommand(lsCommand* command, FILE* out, FILE* err);
 
-void longFormatPrint(lsRequestedItem* printableFolders, int startIndex, int step, int numItems, int i);
\ No newline at end of file
+int terminalWidth(void);
@@ -0,0 +1,34 @@
+#ifndef LSINTERNAL_H
+#define LSINTERNAL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "lsscan.h"
+
+/*
+    What liblsscan's own files share with each other. Callers only include lsscan.h: the Makefile makes
+    every symbol in the archive that doesn't start with ls local, so nothing declared here can clash
+    with a name in the program the library is linked into.
+*/
+
+#define SENTINEL -1
+
+//the names read out of one directory, shared between everyone listing it.
+//names holds count null terminated names back to back
+typedef struct dirNames {
+    char* names;
+    size_t count;
+    int refs;       //protected by the cache lock
+} dirNames;
+
+dirNames* dirCacheGet(lsDirCache* cache, const char* dir, int* error);
+
+void dirCacheRelease(lsDirCache* cache, dirNames* names);
+
+bool hasStatFilters(const lsFilterSet* filters);
+
+bool filterName(const lsFilterSet* filters, const char* name, size_t nameLen);
+
+bool filterStat(const lsFilterSet* filters, const struct stat* fileStat);
+
+#endif
@@ -0,0 +1,822 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <linux/limits.h>
+#include <errno.h>
+#include <sys/xattr.h>
+#include "lsinternal.h"
+#include "idcache.h"
+#include "width.h"
+
+/**
+ * @brief Checks if item is a link using S_ISLNK. Only sets item as a link if S_ISLNK is true,
+ * and the file it points to makes sense
+ * @param item: item we check link status and update link information for.
+ * @param fileStat: stat of the file. used to check for link and to get handle to link endpoint
+ * @param secondCall: If this is the second time calling this function per one file. If so,
+ * the item->link from the first call is freed before it is replaced, so it doesn't leak
+ * @returns if item should be considered a link
+ */
+static void getLinkInfo(lsItem* item, struct stat fileStat, bool secondCall){
+    item->isLink = false;
+    if(S_ISLNK(fileStat.st_mode)){
+        item->pointsToDir = false;
+        item->linkTargetMode = 0;
+        char* pointsTo = calloc(PATH_MAX,1);
+        int nbytes = readlink(item->path,pointsTo,PATH_MAX);
+        char* pointsToPath = nbytes != -1 ? realpath(item->path,NULL) : NULL;
+        // printf("Realpath: %s\n",pointsToPath);
+        //the link may have changed since the first call, so its text is always allocated again
+        if(secondCall){
+            free(item->link);
+            item->link = NULL;
+        }
+        if(nbytes != -1){
+            struct stat linkStat;
+            //realpath() fails for a broken link, and then there is nothing to stat()
+            if(pointsToPath == NULL || stat(pointsToPath,&linkStat)<0){
+                // fprintf(stderr,"stat(%s -> %s) on link endpoint failed: %s\n",item->path,pointsToPath,strerror(errno));
+                item->pointsToDir = false;
+                // free(pointsTo);
+                // free(pointsToPath);
+                // return;
+            }
+            else {
+                item->linkTargetMode = linkStat.st_mode;
+            }
+            item->link = calloc(nbytes+1,1);
+            memcpy(item->link,pointsTo,nbytes);
+            if(item->linkTargetMode != 0 && S_ISDIR(linkStat.st_mode)){
+                // printf("%s points to dir %s\n",item->name,pointsTo);
+                item->pointsToDir = true;
+            }
+            // item->permissions[0] = 'l';
+        }
+        else {
+            //readlink failed, so there is nothing to show after the ->
+            item->link = calloc(1,1);
+        }
+        free(pointsTo);
+        free(pointsToPath);
+        item->isLink = true;
+        item->isDir = false;
+    }
+}
+
+/**
+ * @brief Fills in the -@ mark and the -Z context of an item. Only called when one of them was asked for.
+ * With -@ the attribute names are listed first, so the context is only read for entries that have one,
+ * and entries without attributes cost one syscall
+ * @param item: Its permissions get the mark, and context is set if there is one
+ * @param options: xattrIndicator and securityContext are used
+ */
+static void getXattrInfo(lsItem* item, const lsOptions* options){
+    char mark = ' ';
+    bool hasContext = true;     //without the list of names, just try to read it
+    if(options->xattrIndicator){
+        char names[1024];
+        ssize_t len = llistxattr(item->path,names,sizeof(names));
+        if(len == -1 && errno == ERANGE){
+            //too many names to look through here, so only ask about the ACL
+            mark = lgetxattr(item->path,"system.posix_acl_access",NULL,0) >= 0 ? '+' : '@';
+        }
+        else {
+            hasContext = false;
+            for(ssize_t i = 0; i < len; i += strlen(names+i) + 1){
+                if(strcmp(names+i,"system.posix_acl_access") == 0 || strcmp(names+i,"system.posix_acl_default") == 0){
+                    mark = '+';
+                }
+                //every file has a context on SELinux systems, so it doesn't count for @
+                else if(strcmp(names+i,"security.selinux") == 0){
+                    hasContext = true;
+                }
+                else if(mark == ' '){
+                    mark = '@';
+                }
+            }
+        }
+        item->permissions[10] = mark;
+        item->permissions[11] = '\0';
+    }
+    if(options->securityContext && hasContext){
+        char context[256];
+        ssize_t len = lgetxattr(item->path,"security.selinux",context,sizeof(context));
+        if(len > 0){
+            item->context = strndup(context,len);   //the stored value usually ends with a null, strndup stops there
+        }
+    }
+}
+
+/**
+ * @brief Get information (for one file) used in long list format printing
+ * @param item: A pointer to the item information struct. Modified by function.
+ * @param options: Used for -n, which specifies group and owner as numbers, not strings
+ */
+static void getLongListInfo(lsItem* item, const lsOptions* options){
+    char permissions[] = "----------";
+    if(item->isDir == true){
+        permissions[0] = 'd';
+    }
+    item->permissions = malloc(sizeof(permissions) + 1);    //+1 for the -@ mark
+    if(item->lstatSuccessful == false){
+        // fprintf(stderr,"Error: lstat(%s) failed (long listing). %s\n",item->path,strerror(errno));
+        item->hardLinksCount = SENTINEL;
+        strncpy(item->permissions,options->xattrIndicator ? "-????????? " : "-?????????",12);
+        item->owner = "?";
+        item->group = "?";
+        item->itemStat.st_size = SENTINEL; //sentinel value
+        item->itemStat.st_mtime = SENTINEL;
+        return;
+    }
+    strcpy(&permissions[1], (item->itemStat.st_mode & S_IRUSR) ? "r" : "-");
+    strcpy(&permissions[2], (item->itemStat.st_mode & S_IWUSR) ? "w" : "-");
+    strcpy(&permissions[3], (item->itemStat.st_mode & S_IXUSR) ? "x" : "-");
+    strcpy(&permissions[4], (item->itemStat.st_mode & S_IRGRP) ? "r" : "-");
+    strcpy(&permissions[5], (item->itemStat.st_mode & S_IWGRP) ? "w" : "-");
+    strcpy(&permissions[6], (item->itemStat.st_mode & S_IXGRP) ? "x" : "-");
+    strcpy(&permissions[7], (item->itemStat.st_mode & S_IROTH) ? "r" : "-");
+    strcpy(&permissions[8], (item->itemStat.st_mode & S_IWOTH) ? "w" : "-");
+    strcpy(&permissions[9], (item->itemStat.st_mode & S_IXOTH) ? "x" : "-");
+
+    memcpy(item->permissions,permissions,sizeof(permissions));
+    item->hardLinksCount = item->itemStat.st_nlink;
+
+    //names come from the shared uid/gid cache, so each id goes through NSS once
+    item->owner = userName(item->itemStat.st_uid,options->numericIds);
+    item->group = groupName(item->itemStat.st_gid,options->numericIds);
+
+    getLinkInfo(item,item->itemStat,true);
+    if(item->isLink == true){
+        item->permissions[0] = 'l';
+        item->isDir = false;
+    }
+    //extended attributes are only looked at when they are shown
+    if(options->xattrIndicator || options->securityContext){
+        getXattrInfo(item,options);
+    }
+    // printf("name: %s   blocks  %ld\n",item->name,fileStat.st_blocks);
+}
+
+/**
+ * @brief Adds one listed item to its folder's totals
+ * @param item: An item filled in by readItem()
+ * @param folder: The folder the item is listed in
+ */
+static void countItem(const lsItem* item, lsRequestedItem* folder){
+    if(item->lstatSuccessful == false){
+        folder->statErrorCount++;
+        return;
+    }
+    folder->totalBlocks += (item->itemStat.st_blocks/2);
+}
+
+//-a, -A, --include and --exclude. These only need the name, so they are checked before anything else
+static bool nameIsListed(const char* name, size_t nameLen, const lsOptions* options){
+    if(options->hidden == LS_HIDE_DOTFILES){
+        //skip entries that start with .
+        if(name[0] == '.'){
+            return false;
+        }
+    }
+    if(options->hidden == LS_SHOW_ALMOST_ALL){
+        if(strcmp(name,".") == 0 || strcmp(name,"..") == 0){
+            return false;
+        }
+    }
+    return filterName(&options->filters,name,nameLen);
+}
+
+/**
+ * @brief Fills in the information for one directory entry, if it gets listed
+ * @param dir: The directory the entry is in
+ * @param name: d_name of the entry
+ * @param options: Which items to list. hidden and filters decide if this one is
+ * @param item: Filled in by the function if the entry is listed
+ * @param folder: The folder the entry is in, for the block totals
+ * @returns true if the entry is listed, false if it was skipped
+ */
+static bool readItem(const char* dir, const char* name, const lsOptions* options, lsItem* item, lsRequestedItem* folder){
+    //sets these to false so they are not set true by garbage values
+    item->isDir = false;
+    item->isLink = false;
+    item->link = NULL;
+    item->context = NULL;
+    item->permissions = NULL;
+    item->owner = NULL;
+    item->group = NULL;
+
+    //before anything is stat'ed or allocated for this entry
+    size_t nameLen = strnlen(name,256);
+    if(!nameIsListed(name,nameLen,options)){
+        return false;
+    }
+    char itemPath[PATH_MAX+1];      //+1 for newline
+    strncpy(itemPath,dir,PATH_MAX);
+    size_t dirnameLen = strnlen(dir,PATH_MAX-1);
+    if(itemPath[dirnameLen-1] != '/'){
+        itemPath[dirnameLen] = '/';
+        dirnameLen++;
+    }
+    strncat(itemPath,name,PATH_MAX);
+
+    bool statFilters = hasStatFilters(&options->filters);
+    if(lstat(itemPath,&item->itemStat) == -1){
+        item->lstatSuccessful = false;
+        item->lstatErrno = errno;
+        //lstat() leaves it undefined, and the sorts and getLinkInfo() still look at it
+        memset(&item->itemStat,0,sizeof(item->itemStat));
+        //size and time predicates can't be checked, so leave the entry out
+        if(statFilters){
+            return false;
+        }
+    }
+    else {
+        item->lstatSuccessful = true;
+        item->lstatErrno = 0;
+        //size and time predicates, before we copy anything or build long listing info
+        if(statFilters && !filterStat(&options->filters,&item->itemStat)){
+            return false;
+        }
+    }
+    item->name = strndup(name,256);
+    //display width is worked out once here, the grid layout reads it many times
+    item->nameLength = displayWidth(name,nameLen);
+    item->path = strndup(itemPath,PATH_MAX);
+    if(S_ISDIR(item->itemStat.st_mode) == 1){
+        item->isDir = true;
+    }
+    //getLinkInfo is called twice because sometimes S_ISLNK thinks something like .gitignore is a link
+    getLinkInfo(item,item->itemStat,false);
+
+    //owner and group names load NSS the first time, so only look them up for -l
+    if(options->longInfo){
+        getLongListInfo(item,options);
+    }
+    countItem(item,folder);
+    return true;
+}
+
+//frees the strings owned by one item
+static void freeItem(lsItem* item){
+    if(item->isLink){
+        free(item->link);
+    }
+    free(item->name);
+    free(item->path);
+    free(item->permissions);
+    free(item->context);
+}
+
+#define PAGE_START_SIZE 64    //items a listing has room for before it grows. Listings only grow as entries arrive
+
+/**
+ * @brief Doubles the room in an items array
+ * @param items: The array. Left alone if it can't grow
+ * @param capacity: Number of items there is room for. Updated by the function
+ * @returns false if out of memory
+ */
+static bool growItems(lsItem** items, size_t* capacity){
+    if(*capacity > SIZE_MAX/2/sizeof(lsItem)){
+        return false;
+    }
+    lsItem* grown = realloc(*items,*capacity*2*sizeof(lsItem));
+    if(grown == NULL){
+        return false;
+    }
+    *items = grown;
+    *capacity *= 2;
+    return true;
+}
+
+/**
+ * @brief In a given directory, which items do we need to run ls on
+ * Also gives us the path to the items to make lstat() easier
+ * The directory is read once, and folder->items grows as items are found, so it can't overrun
+ * if the directory gains entries while it is being read.
+ * @returns number of items to print. Accounts for -a and -A flags. Also checks if an item is a directory.
+ * @param dir The current directory we are searching through
+ * @param options Which items to list. hidden and filters affect which items are kept
+ * @param folder folder->items gets the items that will be listed when the dir contents are printed.
+ * folder->error is set if the directory can't be opened or memory runs out
+ */
+static int whichItems(const char* dir, const lsOptions* options, lsRequestedItem* folder){
+    struct dirent* dirp;
+    DIR* dp;
+    dp = opendir(dir);
+    if(!dp){
+        //the caller reports the error
+        folder->error = errno;
+        return 0;
+    }
+    size_t capacity = PAGE_START_SIZE;
+    folder->items = malloc(capacity*sizeof(lsItem));
+    if(folder->items == NULL){
+        folder->error = ENOMEM;
+        closedir(dp);
+        return 0;
+    }
+    int dirIndex = 0;
+    while((dirp = readdir(dp)) != NULL){
+        if((size_t)dirIndex == capacity && !growItems(&folder->items,&capacity)){
+            folder->error = ENOMEM;
+            break;
+        }
+        if(readItem(dir,dirp->d_name,options,&folder->items[dirIndex],folder)){
+            dirIndex++;
+        }
+    }
+    closedir(dp);
+    return dirIndex;
+}
+
+static int sortByName(const void* name1, const void* name2){
+    return strcmp( ((lsItem*) name1)->name,((lsItem*) name2)->name);
+}
+
+/**
+ * @brief Compares two items by a sort key. Biggest or newest comes first, and ties go by name,
+ * so the order is the same no matter what order the items were read in. Pages depend on that
+ * @returns negative if item1 comes first, positive if item2 does
+ */
+static int compareByKey(const lsItem* item1, const lsItem* item2, lsSortKey sortKey){
+    long long key1 = 0, key2 = 0;
+    switch(sortKey){
+        case LS_SORT_NAME:
+            break;
+        case LS_SORT_SIZE:
+            key1 = item1->itemStat.st_size;
+            key2 = item2->itemStat.st_size;
+            break;
+        case LS_SORT_MTIME:
+            key1 = item1->itemStat.st_mtime;
+            key2 = item2->itemStat.st_mtime;
+            break;
+        case LS_SORT_ATIME:
+            key1 = item1->itemStat.st_atime;
+            key2 = item2->itemStat.st_atime;
+            break;
+        case LS_SORT_CTIME:
+            key1 = item1->itemStat.st_ctime;
+            key2 = item2->itemStat.st_ctime;
+            break;
+    }
+    if(key1 != key2){
+        return key1 > key2 ? -1 : 1;
+    }
+    return strcmp(item1->name,item2->name);
+}
+
+//size, highest size first
+static int sortBySize(const void* item1, const void* item2){
+    return compareByKey(item1,item2,LS_SORT_SIZE);
+}
+
+//sort by modified time
+static int sortByMtime(const void* item1, const void* item2){
+    return compareByKey(item1,item2,LS_SORT_MTIME);
+}
+
+//sort by access time
+static int sortByAtime(const void* item1, const void* item2){
+    return compareByKey(item1,item2,LS_SORT_ATIME);
+}
+
+//sort by status change time
+static int sortByCtime(const void* item1, const void* item2){
+    return compareByKey(item1,item2,LS_SORT_CTIME);
+}
+
+//where item1 goes relative to item2 in the finished listing, -r included
+static int compareItems(const lsItem* item1, const lsItem* item2, const lsOptions* options){
+    int order = compareByKey(item1,item2,options->sortKey);
+    return options->reverse ? -order : order;
+}
+
+//reverses the order of a folder's items, for -r
+static void reverseItems(lsRequestedItem* folder){
+    int left = 0, right = folder->itemCount - 1;
+    while(left < right){
+        lsItem temp = folder->items[left];
+        folder->items[left] = folder->items[right];
+        folder->items[right] = temp;
+        left++;
+        right--;
+    }
+}
+
+/**
+ * @brief Sorts the items of a folder according to the options. Items with the same size or time
+ * stay in name order
+ * @param folder: Folder whose items get sorted
+ * @param options: sortKey, unsorted and reverse are used
+ */
+static void sortItems(lsRequestedItem* folder, const lsOptions* options){
+    switch(options->sortKey){
+        case LS_SORT_NAME:
+            //if no f flag, sort output (by name)
+            //if f flag is present, do not sort output
+            if(!options->unsorted){
+                qsort(folder->items,folder->itemCount,sizeof(lsItem),sortByName);
+            }
+            break;
+        case LS_SORT_SIZE:     //size, highest size first
+            qsort(folder->items,folder->itemCount,sizeof(lsItem),sortBySize);
+            break;
+        case LS_SORT_MTIME:    //modified time
+            qsort(folder->items,folder->itemCount,sizeof(lsItem),sortByMtime);
+            break;
+        case LS_SORT_ATIME:    //access time
+            qsort(folder->items,folder->itemCount,sizeof(lsItem),sortByAtime);
+            break;
+        case LS_SORT_CTIME:    //status change time
+            qsort(folder->items,folder->itemCount,sizeof(lsItem),sortByCtime);
+            break;
+    }
+    //go in reverse if -r flag is specified
+    if(options->reverse){
+        reverseItems(folder);
+    }
+}
+
+//moves the worst item of the page heap down until the heap is in order again
+static void siftDown(lsItem* heap, size_t count, size_t index, const lsOptions* options){
+    while(true){
+        size_t worst = index, left = 2*index + 1, right = 2*index + 2;
+        if(left < count && compareItems(&heap[left],&heap[worst],options) > 0){
+            worst = left;
+        }
+        if(right < count && compareItems(&heap[right],&heap[worst],options) > 0){
+            worst = right;
+        }
+        if(worst == index){
+            return;
+        }
+        lsItem temp = heap[index];
+        heap[index] = heap[worst];
+        heap[worst] = temp;
+        index = worst;
+    }
+}
+
+static void siftUp(lsItem* heap, size_t index, const lsOptions* options){
+    while(index > 0 && compareItems(&heap[index],&heap[(index-1)/2],options) > 0){
+        lsItem temp = heap[index];
+        heap[index] = heap[(index-1)/2];
+        heap[(index-1)/2] = temp;
+        index = (index-1)/2;
+    }
+}
+
+/**
+ * @brief One page of a sorted listing. Only the first offset+limit entries in sorted order are kept while
+ * reading, in a heap with the entry that sorts last on top, so memory does not grow with the directory
+ * @returns 0, the errno from opening the directory, or ENOMEM
+ */
+static int listSortedPage(const char* dir, const lsOptions* options, lsRequestedItem* folder){
+    dirNames* names = NULL;
+    DIR* dp = NULL;
+    if(options->dirCache != NULL){
+        names = dirCacheGet(options->dirCache,dir,&folder->error);
+    }
+    else if((dp = opendir(dir)) == NULL){
+        folder->error = errno;
+    }
+    if(folder->error != 0){
+        return folder->error;
+    }
+    size_t keep = options->offset + options->limit;     //lsListDir() makes sure this doesn't overflow
+    size_t capacity = keep < PAGE_START_SIZE ? keep : PAGE_START_SIZE;
+    lsItem* heap = malloc(capacity*sizeof(lsItem));
+    if(heap == NULL){
+        if(names != NULL){
+            dirCacheRelease(options->dirCache,names);
+        }
+        else {
+            closedir(dp);
+        }
+        folder->error = ENOMEM;
+        return folder->error;
+    }
+    size_t heapCount = 0;
+    lsRequestedItem skipped;    //totals only count what ends up on the page
+    memset(&skipped,0,sizeof(skipped));
+    const char* nextName = names != NULL ? names->names : NULL;
+    size_t namesLeft = names != NULL ? names->count : 0;
+    while(true){
+        const char* name;
+        if(names != NULL){
+            if(namesLeft == 0){
+                break;
+            }
+            name = nextName;
+            nextName += strlen(nextName) + 1;
+            namesLeft--;
+        }
+        else {
+            struct dirent* dirp = readdir(dp);
+            if(dirp == NULL){
+                break;
+            }
+            name = dirp->d_name;
+        }
+        //in name order the name says if the entry can make the page, so don't lstat the ones that can't
+        if(heapCount == keep && options->sortKey == LS_SORT_NAME){
+            int order = strcmp(name,heap[0].name);
+            if((options->reverse ? -order : order) >= 0){
+                continue;
+            }
+        }
+        lsItem item;
+        if(!readItem(dir,name,options,&item,&skipped)){
+            continue;
+        }
+        if(heapCount < keep){
+            if(heapCount == capacity && !growItems(&heap,&capacity)){
+                freeItem(&item);
+                folder->error = ENOMEM;
+                break;
+            }
+            heap[heapCount] = item;
+            siftUp(heap,heapCount,options);
+            heapCount++;
+        }
+        else if(compareItems(&item,&heap[0],options) < 0){
+            freeItem(&heap[0]);
+            heap[0] = item;
+            siftDown(heap,heapCount,0,options);
+        }
+        else {
+            freeItem(&item);
+        }
+    }
+    if(names != NULL){
+        dirCacheRelease(options->dirCache,names);
+    }
+    else {
+        closedir(dp);
+    }
+    if(folder->error != 0){
+        for(size_t i = 0; i < heapCount; i++){
+            freeItem(&heap[i]);
+        }
+        free(heap);
+        return folder->error;
+    }
+
+    //take the heap apart from the back, so it ends up in sorted order
+    for(size_t end = heapCount; end > 1; end--){
+        lsItem temp = heap[0];
+        heap[0] = heap[end-1];
+        heap[end-1] = temp;
+        siftDown(heap,end-1,0,options);
+    }
+    size_t start = options->offset < heapCount ? options->offset : heapCount;
+    for(size_t i = 0; i < start; i++){
+        freeItem(&heap[i]);
+    }
+    folder->itemCount = heapCount - start;
+    memmove(heap,heap+start,folder->itemCount*sizeof(lsItem));
+    folder->items = heap;
+    for(int i = 0; i < folder->itemCount; i++){
+        countItem(&folder->items[i],folder);
+    }
+    return 0;
+}
+
+/**
+ * @brief One page of an unsorted (-f) listing, read straight from the directory stream. Entries before
+ * the offset are only counted, and reading stops as soon as the page is full
+ * @returns 0, the errno from opening the directory, EINVAL if the cursor is for another directory, or ENOMEM
+ */
+static int listStreamPage(const char* dir, const lsOptions* options, lsRequestedItem* folder){
+    DIR* dp = opendir(dir);
+    if(!dp){
+        folder->error = errno;
+        return folder->error;
+    }
+    struct stat dirStat;
+    if(fstat(dirfd(dp),&dirStat) == -1){
+        folder->error = errno;
+        closedir(dp);
+        return folder->error;
+    }
+    if(options->hasCursor){
+        if(options->cursor.dirDev != dirStat.st_dev || options->cursor.dirIno != dirStat.st_ino){
+            folder->error = EINVAL;
+            closedir(dp);
+            return folder->error;
+        }
+        seekdir(dp,options->cursor.position);
+    }
+    size_t capacity = options->limit != 0 && options->limit < PAGE_START_SIZE ? options->limit : PAGE_START_SIZE;
+    folder->items = malloc(capacity*sizeof(lsItem));
+    if(folder->items == NULL){
+        folder->error = ENOMEM;
+        closedir(dp);
+        return folder->error;
+    }
+    bool statFilters = hasStatFilters(&options->filters);
+    lsRequestedItem skipped;
+    memset(&skipped,0,sizeof(skipped));
+    size_t toSkip = options->offset;
+    struct dirent* dirp;
+    while((dirp = readdir(dp)) != NULL){
+        if(toSkip > 0){
+            //without size or time filters the name is enough to know if the entry counts
+            if(!statFilters){
+                if(nameIsListed(dirp->d_name,strnlen(dirp->d_name,256),options)){
+                    toSkip--;
+                }
+                continue;
+            }
+            lsItem item;
+            if(readItem(dir,dirp->d_name,options,&item,&skipped)){
+                freeItem(&item);
+                toSkip--;
+            }
+            continue;
+        }
+        if((size_t)folder->itemCount == capacity && !growItems(&folder->items,&capacity)){
+            folder->error = ENOMEM;
+            break;
+        }
+        if(readItem(dir,dirp->d_name,options,&folder->items[folder->itemCount],folder)){
+            folder->itemCount++;
+        }
+        if(options->limit != 0 && (size_t)folder->itemCount == options->limit){
+            //the next page starts right after this entry, if there is anything left to read
+            long position = telldir(dp);
+            if(readdir(dp) != NULL){
+                folder->hasNextCursor = true;
+                folder->nextCursor.dirDev = dirStat.st_dev;
+                folder->nextCursor.dirIno = dirStat.st_ino;
+                folder->nextCursor.position = position;
+            }
+            break;
+        }
+    }
+    closedir(dp);
+    if(folder->error != 0){
+        return folder->error;
+    }
+    //-r turns the page around, not the whole directory
+    if(options->reverse){
+        reverseItems(folder);
+    }
+    return 0;
+}
+
+//--offset without --limit: the whole directory was read, so drop the front of it and redo the totals
+static void dropOffset(lsRequestedItem* folder, const lsOptions* options){
+    if(options->offset == 0){
+        return;
+    }
+    int start = options->offset < (size_t)folder->itemCount ? (int)options->offset : folder->itemCount;
+    for(int i = 0; i < start; i++){
+        freeItem(&folder->items[i]);
+    }
+    folder->itemCount -= start;
+    memmove(folder->items,folder->items+start,folder->itemCount*sizeof(lsItem));
+    folder->totalBlocks = 0;
+    folder->statErrorCount = 0;
+    for(int i = 0; i < folder->itemCount; i++){
+        countItem(&folder->items[i],folder);
+    }
+}
+
+/**
+ * @brief Reads and sorts one directory
+ * @param dir: Path to the directory
+ * @param options: What to list and how to sort it
+ * @param folder: Filled in by the function. Free with lsFreeDir(), even if an error is returned
+ * @returns 0, the errno from opening the directory, ENOMEM, or EINVAL if offset plus limit doesn't fit in a size_t
+ */
+int lsListDir(const char* dir, const lsOptions* options, lsRequestedItem* folder){
+    memset(folder,0,sizeof(lsRequestedItem));
+    //a sorted page keeps offset+limit entries
+    if(options->offset > SIZE_MAX - options->limit){
+        folder->error = EINVAL;
+        return folder->error;
+    }
+    //the cursor is a position in the directory stream, so it always reads the directory itself
+    if(options->hasCursor || (options->unsorted && options->sortKey == LS_SORT_NAME && (options->offset != 0 || options->limit != 0))){
+        return listStreamPage(dir,options,folder);
+    }
+    if(options->limit != 0){
+        return listSortedPage(dir,options,folder);
+    }
+    if(options->dirCache != NULL){
+        //names come from the cache, only the lstat()s are redone
+        dirNames* names = dirCacheGet(options->dirCache,dir,&folder->error);
+        if(names == NULL){
+            return folder->error;
+        }
+        folder->items = (lsItem*)malloc(names->count*sizeof(lsItem));
+        if(folder->items == NULL && names->count != 0){
+            dirCacheRelease(options->dirCache,names);
+            folder->error = ENOMEM;
+            return folder->error;
+        }
+        const char* name = names->names;
+        for(size_t i = 0; i < names->count; i++){
+            if(readItem(dir,name,options,&folder->items[folder->itemCount],folder)){
+                folder->itemCount++;
+            }
+            name += strlen(name) + 1;
+        }
+        dirCacheRelease(options->dirCache,names);
+        sortItems(folder,options);
+        dropOffset(folder,options);
+            return 0;
+    }
+    folder->itemCount = whichItems(dir,options,folder);
+    if(folder->error != 0){
+        return folder->error;
+    }
+    sortItems(folder,options);
+    dropOffset(folder,options);
+    return 0;
+}
+
+/**
+ * @brief The ls logic itself. Populates the structs above with information about folders and files in those
+ * folders so we can print them.
+ * @param options: What to list and how to sort it
+ * @param argTargetCount: number of lsTargets passed in through argv. Not all can be used, since some may not exist or have bad permissions.
+ * @param printTargetCount: number of directories we actually print the contents of. Modified by the function.
+ * @param lsTargets: A 2d array of all the directories/items we need to try to run ls on
+ * @param folders: A (blank) array of structs that contains information we need for printing the contents of a folder.
+ *      Modified by function. Folders that could not be read have error set
+*/
+void lsListTargets(const lsOptions* options, int argTargetCount, int* printTargetCount, char** const lsTargets, lsRequestedItem* folders){
+    *printTargetCount = argTargetCount;
+    //main loop. ls for one directory at a time
+    for(int i = 0; i < argTargetCount; i++){
+        if(lsListDir(lsTargets[i],options,&folders[i]) != 0){
+            //we cannot open this directory, so move on to the next one.
+            (*printTargetCount)--;
+        }
+    }
+}
+
+/**
+ * @brief Lists a directory, calling back once per entry in sorted order
+ * @param dir: Path to the directory
+ * @param options: What to list and how to sort it
+ * @param callback: Called for each entry. The item is only valid during the call. Returning nonzero stops the listing
+ * @param context: Passed through to the callback
+ * @returns 0, or an error from lsListDir()
+ */
+int lsForEach(const char* dir, const lsOptions* options, lsEntryCallback callback, void* context){
+    lsRequestedItem folder;
+    int error = lsListDir(dir,options,&folder);
+    if(error == 0){
+        for(int i = 0; i < folder.itemCount; i++){
+            if(callback(&folder.items[i],context) != 0){
+                break;
+            }
+        }
+    }
+    lsFreeDir(&folder);
+    return error;
+}
+
+/**
+ * @brief Turns a cursor into text that can be handed to a client
+ * @param cursor: A cursor from lsRequestedItem.nextCursor
+ * @param text: At least LS_CURSOR_MAX bytes
+ */
+void lsFormatCursor(const lsCursor* cursor, char* text){
+    snprintf(text,LS_CURSOR_MAX,"%llx.%llx.%lx",(unsigned long long)cursor->dirDev,(unsigned long long)cursor->dirIno,
+        (unsigned long)cursor->position);
+}
+
+/**
+ * @brief Reads a cursor written by lsFormatCursor()
+ * @returns false if the text is not a cursor
+ */
+bool lsParseCursor(const char* text, lsCursor* cursor){
+    unsigned long long dirDev, dirIno;
+    unsigned long position;
+    int used = 0;
+    if(sscanf(text,"%llx.%llx.%lx%n",&dirDev,&dirIno,&position,&used) != 3 || text[used] != '\0'){
+        return false;
+    }
+    cursor->dirDev = dirDev;
+    cursor->dirIno = dirIno;
+    cursor->position = (long)position;
+    return true;
+}
+
+//frees everything lsListDir() allocated for a folder
+void lsFreeDir(lsRequestedItem* folder){
+    for(int i = 0; i < folder->itemCount; i++){
+        freeItem(&folder->items[i]);
+    }
+    free(folder->items);
+    folder->items = NULL;
+    folder->itemCount = 0;
+}
@@ -0,0 +1,134 @@
+#ifndef LSSCAN_H
+#define LSSCAN_H
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "filter.h"
+#include "dircache.h"
+
+/*
+    liblsscan: the directory scanning part of ls, without any printing.
+    Nothing in here touches global state besides the uid/gid name cache, which is locked,
+    so any number of threads can list directories at the same time.
+
+    The simplest way in is lsForEach(), which calls back once per entry in sorted order:
+
+        int printName(const lsItem* item, void* context){
+            puts(item->name);
+            return 0;       //nonzero stops the listing early
+        }
+        lsOptions options = {0};
+        lsForEach("/tmp",&options,printName,NULL);
+
+    lsListDir() hands back the whole sorted listing instead, freed with lsFreeDir().
+    Owner and group names stay cached until lsIdCacheClear().
+
+    Every name the library exports, and every name in its public headers, starts with ls or LS_.
+    Laying the listing out (column widths, padding, folder headers) is left to the caller.
+
+    Set offset and limit in lsOptions to get one page of a listing. Only the page is kept in memory:
+    sorted listings keep the best offset+limit entries seen so far while reading, and with -f entries
+    are taken straight from the directory stream. With -f, a page that stops early sets nextCursor,
+    which can be passed back in lsOptions to pick up right after it without reading the skipped
+    entries again. lsFormatCursor() and lsParseCursor() turn cursors into text and back.
+*/
+
+#define LS_CURSOR_MAX 56    //longest cursor text, with the null terminator
+
+//which entries starting with '.' get listed
+typedef enum lsHidden {
+    LS_HIDE_DOTFILES,      //default
+    LS_SHOW_ALMOST_ALL,    //-A: everything but . and ..
+    LS_SHOW_ALL            //-a
+} lsHidden;
+
+//what the listing is sorted by. Ties keep name order
+typedef enum lsSortKey {
+    LS_SORT_NAME,
+    LS_SORT_SIZE,      //-S
+    LS_SORT_MTIME,     //-t
+    LS_SORT_ATIME,     //-u
+    LS_SORT_CTIME      //-c
+} lsSortKey;
+
+//a position in a directory stream, from telldir(). Only means something for the directory it came from
+typedef struct lsCursor {
+    dev_t dirDev;       //both checked when the cursor is used, so a cursor for another directory is refused,
+    ino_t dirIno;       //even one on another filesystem with the same inode number
+    long position;
+} lsCursor;
+
+//everything that changes what a listing contains or what order it is in
+typedef struct lsOptions {
+    lsHidden hidden;
+    lsSortKey sortKey;
+    bool unsorted;      //-f: leave entries in directory order, unless sortKey is not LS_SORT_NAME
+    bool reverse;       //-r
+    bool longInfo;      //fill in permissions, owner and group, what -l shows. Names go through NSS, so leave
+                        //this off when they aren't printed
+    bool numericIds;    //-n: owner and group are ids instead of names
+    bool xattrIndicator;    //-@: add + (ACL) or @ (other extended attributes) after the permissions
+    bool securityContext;   //-Z: read each entry's SELinux context
+    lsFilterSet filters;  //--include, --exclude, --min-size, ...
+    lsDirCache* dirCache;   //optional. Reuses directory reads between listings, see dircache.c
+    size_t offset;      //leave out this many entries from the start of the listing
+    size_t limit;       //list at most this many entries. 0 lists everything
+    bool hasCursor;     //only with unsorted name order: start reading the directory at cursor
+    lsCursor cursor;
+} lsOptions;
+
+//these are filled in and sorted by lsListDir()
+
+//Contains information about each file in a directory
+typedef struct lsItem {
+    char* name;     //name of the file itself
+    char* path;     //path to file - used for stat()
+    int nameLength; //display width of file name in terminal columns
+    bool isDir;     //Used for colorization
+
+    struct stat itemStat;   //stat information for each file in a directory
+
+    char* permissions;  //permissions of the file, with the -@ mark at the end if asked for
+    char* context;      //-Z: security context, NULL if there is none or it wasn't asked for
+    int hardLinksCount;
+    const char* owner;  //owned by the uid/gid name cache, not freed with the item
+    const char* group;
+    bool lstatSuccessful;
+    int lstatErrno;     //errno from lstat() if it failed
+    char* link;     //where the link points to if the file is a link
+    bool pointsToDir;   //if the file is a link, then does the file point to a directory?
+    mode_t linkTargetMode;  //if the file is a link, st_mode of the file it points to. 0 if the link is broken
+    bool isLink;
+
+} lsItem;        //each item in a directory
+
+//information about one ls target we are reading
+typedef struct lsRequestedItem {
+    lsItem* items;   //array of item info structures for that directory
+    int itemCount;      //number of items in directory
+    int error;          //errno if the folder could not be read, 0 otherwise
+    int statErrorCount; //number of items where lstat() failed
+    size_t totalBlocks;   //for -l, shows sum of size of all the items in the directory
+    bool hasNextCursor;   //a paged -f listing stopped before the end of the directory
+    lsCursor nextCursor;  //where the next page starts
+} lsRequestedItem;           //one folder read by ls
+
+//called once per entry by lsForEach(). Returning nonzero stops the listing
+typedef int (*lsEntryCallback)(const lsItem* item, void* context);
+
+int lsListDir(const char* dir, const lsOptions* options, lsRequestedItem* folder);
+
+void lsListTargets(const lsOptions* options, int argTargetCount, int* printTargetCount, char** const lsTargets, lsRequestedItem* folders);
+
+int lsForEach(const char* dir, const lsOptions* options, lsEntryCallback callback, void* context);
+
+void lsFormatCursor(const lsCursor* cursor, char* text);
+
+bool lsParseCursor(const char* text, lsCursor* cursor);
+
+void lsFreeDir(lsRequestedItem* folder);
+
+void lsIdCacheClear(void);
+
+#endif
@@ -0,0 +1,506 @@
+#define _GNU_SOURCE     //struct ucred, for SO_PEERCRED
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <linux/limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include "ls.h"
+
+#define QUEUE_SIZE 64           //accepted connections waiting for a worker. accept() stops when full
+#define MAX_REQUEST (1 << 20)
+#define DIR_CACHE_SIZE 1024     //directories whose names are kept between requests
+#define REQUEST_TIMEOUT 5       //seconds a client gets to send its request, and for each write of the reply
+
+//connections waiting for a worker thread
+typedef struct requestQueue {
+    int fds[QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} requestQueue;
+
+static requestQueue queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .notEmpty = PTHREAD_COND_INITIALIZER,
+    .notFull = PTHREAD_COND_INITIALIZER
+};
+//getopt keeps global state, so only one request is parsed at a time
+static pthread_mutex_t parseLock = PTHREAD_MUTEX_INITIALIZER;
+static lsDirCache* dirCache = NULL;
+
+static void putU8(FILE* out, uint8_t value){
+    fputc(value,out);
+}
+
+static void putU16(FILE* out, uint16_t value){
+    fputc(value & 0xFF,out);
+    fputc(value >> 8,out);
+}
+
+static void putU32(FILE* out, uint32_t value){
+    for(int i = 0; i < 4; i++){
+        fputc((value >> (8*i)) & 0xFF,out);
+    }
+}
+
+static void putU64(FILE* out, uint64_t value){
+    for(int i = 0; i < 8; i++){
+        fputc((value >> (8*i)) & 0xFF,out);
+    }
+}
+
+static uint64_t getLE(const unsigned char* bytes, int count){
+    uint64_t value = 0;
+    for(int i = count - 1; i >= 0; i--){
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+//strings in records are a u16 length and then the bytes
+static void putString(FILE* out, const char* text){
+    size_t len = text != NULL ? strlen(text) : 0;
+    if(len > UINT16_MAX){
+        len = UINT16_MAX;
+    }
+    putU16(out,(uint16_t)len);
+    //text may be NULL, which fwrite() isn't allowed even for 0 bytes
+    if(len > 0){
+        fwrite(text,1,len,out);
+    }
+}
+
+/**
+ * @brief Writes listings as binary records instead of text. See server.h for the format
+ * @param out: Where the records are written
+ * @param folders: Folders filled in by lsListTargets()
+ * @param folderCount: Number of folders
+ * @param targets: The path of each folder, as given on the command line
+ */
+void writeRecords(FILE* out, lsRequestedItem* folders, int folderCount, char** targets){
+    for(int i = 0; i < folderCount; i++){
+        putU8(out,'D');
+        putU32(out,(uint32_t)folders[i].error);
+        putString(out,targets[i]);
+        putU64(out,folders[i].totalBlocks);
+        putU32(out,(uint32_t)folders[i].itemCount);
+        for(int j = 0; j < folders[i].itemCount; j++){
+            lsItem* item = &folders[i].items[j];
+            bool ok = item->lstatSuccessful;
+            putU8(out,'E');
+            putString(out,item->name);
+            putU32(out,ok ? item->itemStat.st_mode : 0);
+            putU64(out,ok ? (uint64_t)item->itemStat.st_size : 0);
+            putU64(out,ok ? (uint64_t)item->itemStat.st_mtim.tv_sec : 0);
+            putU32(out,ok ? (uint32_t)item->itemStat.st_mtim.tv_nsec : 0);
+            putU32(out,ok ? item->itemStat.st_uid : 0);
+            putU32(out,ok ? item->itemStat.st_gid : 0);
+            putU64(out,ok ? item->itemStat.st_nlink : 0);
+            putU64(out,ok ? item->itemStat.st_ino : 0);
+            putU32(out,(uint32_t)item->lstatErrno);
+            putString(out,item->owner);
+            putString(out,item->group);
+            putString(out,item->isLink ? item->link : NULL);
+        }
+        if(folders[i].hasNextCursor){
+            char cursor[LS_CURSOR_MAX];
+            lsFormatCursor(&folders[i].nextCursor,cursor);
+            putU8(out,'C');
+            putString(out,cursor);
+        }
+    }
+    putU8(out,'Z');
+}
+
+static bool writeAll(int fd, const char* data, size_t len){
+    while(len > 0){
+        ssize_t written = write(fd,data,len);
+        if(written == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* data, size_t len){
+    while(len > 0){
+        ssize_t got = read(fd,data,len);
+        if(got == -1 && errno == EINTR){
+            continue;
+        }
+        if(got <= 0){
+            return false;
+        }
+        data += got;
+        len -= got;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a request, up to the empty string that ends it
+ * @param fd: The client connection
+ * @param length: Set to the length of the request
+ * @returns the request, or NULL if the client went away, sent too much or took longer than REQUEST_TIMEOUT
+ */
+static char* readRequest(int fd, size_t* length){
+    size_t used = 0, capacity = 4096;
+    char* request = malloc(capacity);
+    if(request == NULL){
+        return NULL;
+    }
+    //each read() gives up after REQUEST_TIMEOUT on its own, this stops a client that sends a byte at a time
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    while(used < 2 || request[used-1] != '\0' || request[used-2] != '\0'){
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        if(now.tv_sec - start.tv_sec >= REQUEST_TIMEOUT){
+            free(request);
+            return NULL;
+        }
+        if(used == capacity){
+            char* grown = capacity < MAX_REQUEST ? realloc(request,capacity*2) : NULL;
+            if(grown == NULL){
+                free(request);
+                return NULL;
+            }
+            request = grown;
+            capacity *= 2;
+        }
+        ssize_t got = read(fd,request+used,capacity-used);
+        if(got == -1 && errno == EINTR){
+            continue;
+        }
+        if(got <= 0){
+            free(request);
+            return NULL;
+        }
+        used += got;
+    }
+    *length = used;
+    return request;
+}
+
+//makes a relative path relative to dir. Frees path and returns the new one
+static char* resolvePath(const char* dir, char* path){
+    if(path == NULL || path[0] == '/'){
+        return path;
+    }
+    char* resolved = malloc(strlen(dir) + strlen(path) + 2);
+    sprintf(resolved,"%s/%s",dir,path);
+    free(path);
+    return resolved;
+}
+
+/**
+ * @brief Makes relative targets and snapshot files relative to the client's working directory instead of
+ * the server's. Targets are still printed the way the client typed them.
+ */
+static void resolveTargets(lsCommand* command, const char* cwd){
+    if(cwd == NULL || cwd[0] == '\0'){
+        return;
+    }
+    command->shownTargets = calloc(command->targetCount,sizeof(char*));
+    for(int i = 0; i < command->targetCount; i++){
+        command->shownTargets[i] = strdup(command->targets[i]);
+        command->targets[i] = resolvePath(cwd,command->targets[i]);
+    }
+    command->snapshotPath = resolvePath(cwd,command->snapshotPath);
+    command->diffPath = resolvePath(cwd,command->diffPath);
+}
+
+static void sendReply(int fd, int status, const char* output, size_t outputLen, const char* errors, size_t errorsLen){
+    char header[24];
+    memcpy(header,LSD_MAGIC,4);
+    for(int i = 0; i < 4; i++){
+        header[4+i] = ((uint32_t)status >> (8*i)) & 0xFF;
+    }
+    for(int i = 0; i < 8; i++){
+        header[8+i] = ((uint64_t)outputLen >> (8*i)) & 0xFF;
+        header[16+i] = ((uint64_t)errorsLen >> (8*i)) & 0xFF;
+    }
+    if(writeAll(fd,header,sizeof(header)) && writeAll(fd,output,outputLen)){
+        writeAll(fd,errors,errorsLen);
+    }
+}
+
+/**
+ * @brief Answers one request. Runs on a worker thread
+ * @param fd: The client connection
+ */
+static void handleRequest(int fd){
+    size_t requestLen;
+    char* request = readRequest(fd,&requestLen);
+    if(request == NULL){
+        return;
+    }
+    //split the request into its strings. The last one is the empty terminator
+    int stringCount = 0;
+    for(size_t i = 0; i < requestLen; i++){
+        if(request[i] == '\0'){
+            stringCount++;
+        }
+    }
+    char** strings = malloc((stringCount+1)*sizeof(char*));
+    char* next = request;
+    for(int i = 0; i < stringCount; i++){
+        strings[i] = next;
+        next += strlen(next) + 1;
+    }
+
+    char* output = NULL;
+    char* errors = NULL;
+    size_t outputLen = 0, errorsLen = 0;
+    FILE* out = open_memstream(&output,&outputLen);
+    FILE* err = open_memstream(&errors,&errorsLen);
+    int status = 2;
+
+    //header strings, then arguments, then the empty terminator
+    if(stringCount < 4 || strcmp(strings[0],LSD_MAGIC) != 0 || strncmp(strings[1],"columns=",8) != 0 ||
+        strncmp(strings[2],"cwd=",4) != 0){
+        fprintf(err,"ls: bad request\n");
+    }
+    else {
+        int argc = stringCount - 3;     //arguments, plus argv[0]
+        char** argv = malloc((argc+1)*sizeof(char*));
+        argv[0] = "ls";
+        for(int i = 1; i < argc; i++){
+            argv[i] = strings[i+2];
+        }
+        argv[argc] = NULL;
+
+        lsCommand command;
+        pthread_mutex_lock(&parseLock);
+        status = parseArgs(argc,argv,&command,err);
+        pthread_mutex_unlock(&parseLock);
+        if(status == 0 && (command.serverPath != NULL || command.connectPath != NULL)){
+            fprintf(err,"ls: --server and --connect can't be sent to a server\n");
+            status = 2;
+        }
+        //the server would open these files with its own permissions, not the client's
+        if(status == 0 && (command.snapshotPath != NULL || command.diffPath != NULL)){
+            fprintf(err,"ls: --snapshot and --diff can't be sent to a server\n");
+            status = 2;
+        }
+        if(status == 0 && !parsePositiveInt(strings[1]+8,&command.columns)){
+            fprintf(err,"ls: invalid terminal width '%s'\n",strings[1]+8);
+            status = 2;
+        }
+        if(status == 0){
+            command.options.dirCache = dirCache;
+            resolveTargets(&command,strings[2]+4);
+            status = runCommand(&command,out,err);
+        }
+        freeCommand(&command);
+        free(argv);
+    }
+    fclose(out);
+    fclose(err);
+    sendReply(fd,status,output,outputLen,errors,errorsLen);
+    free(output);
+    free(errors);
+    free(strings);
+    free(request);
+}
+
+//adds a connection to the queue, waiting while it is full
+static void pushRequest(int fd){
+    pthread_mutex_lock(&queue.lock);
+    while(queue.count == QUEUE_SIZE){
+        pthread_cond_wait(&queue.notFull,&queue.lock);
+    }
+    queue.fds[(queue.head + queue.count) % QUEUE_SIZE] = fd;
+    queue.count++;
+    pthread_cond_signal(&queue.notEmpty);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+static int popRequest(void){
+    pthread_mutex_lock(&queue.lock);
+    while(queue.count == 0){
+        pthread_cond_wait(&queue.notEmpty,&queue.lock);
+    }
+    int fd = queue.fds[queue.head];
+    queue.head = (queue.head + 1) % QUEUE_SIZE;
+    queue.count--;
+    pthread_cond_signal(&queue.notFull);
+    pthread_mutex_unlock(&queue.lock);
+    return fd;
+}
+
+static void* worker(void* unused){
+    (void)unused;
+    while(true){
+        int fd = popRequest();
+        handleRequest(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs ls as a server. Never returns unless the socket fails
+ * @param socketPath: Where to create the Unix domain socket. An existing file there is replaced
+ * @param threadCount: How many requests are worked on at once
+ * @returns exit status
+ */
+int runServer(const char* socketPath, int threadCount){
+    struct sockaddr_un address;
+    memset(&address,0,sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(socketPath) >= sizeof(address.sun_path)){
+        fprintf(stderr,"ls: socket path too long: %s\n",socketPath);
+        return 2;
+    }
+    strcpy(address.sun_path,socketPath);
+
+    //a client that hangs up early should not kill the server
+    signal(SIGPIPE,SIG_IGN);
+    tzset();
+
+    int listenFd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(listenFd == -1){
+        fprintf(stderr,"ls: socket: %s\n",strerror(errno));
+        return 1;
+    }
+    unlink(socketPath);
+    //the socket is only for the user running the server
+    mode_t oldMask = umask(0077);
+    int bound = bind(listenFd,(struct sockaddr*)&address,sizeof(address));
+    umask(oldMask);
+    if(bound == -1 || listen(listenFd,QUEUE_SIZE) == -1){
+        fprintf(stderr,"ls: cannot listen on '%s': %s\n",socketPath,strerror(errno));
+        close(listenFd);
+        return 1;
+    }
+
+    dirCache = lsDirCacheNew(DIR_CACHE_SIZE);
+    for(int i = 0; i < threadCount; i++){
+        pthread_t thread;
+        if(pthread_create(&thread,NULL,worker,NULL) != 0){
+            fprintf(stderr,"ls: cannot start worker thread\n");
+            return 1;
+        }
+        pthread_detach(thread);
+    }
+
+    while(true){
+        int fd = accept(listenFd,NULL,NULL);
+        if(fd == -1){
+            if(errno == EINTR || errno == ECONNABORTED){
+                continue;
+            }
+            fprintf(stderr,"ls: accept: %s\n",strerror(errno));
+            break;
+        }
+        //the socket's mode already keeps other users out, this also covers a socket made in a shared directory
+        struct ucred peer;
+        socklen_t peerLen = sizeof(peer);
+        if(getsockopt(fd,SOL_SOCKET,SO_PEERCRED,&peer,&peerLen) == -1 || peer.uid != getuid()){
+            close(fd);
+            continue;
+        }
+        //a client that stops reading or writing gets dropped instead of holding a worker forever
+        struct timeval timeout = {.tv_sec = REQUEST_TIMEOUT, .tv_usec = 0};
+        setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+        setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&timeout,sizeof(timeout));
+        pushRequest(fd);
+    }
+    close(listenFd);
+    return 1;
+}
+
+/**
+ * @brief Sends a command line to a server and prints the reply
+ * @param socketPath: The server's socket
+ * @param columns: Terminal width, sent along for the grid
+ * @param argc: number of arguments
+ * @param argv: The command line as typed. --connect and its argument are left out of the request,
+ * and so are empty arguments, since an empty string ends the request
+ * @returns the exit status from the server
+ */
+int runClient(const char* socketPath, int columns, int argc, char** argv){
+    char* request = NULL;
+    size_t requestLen = 0;
+    FILE* requestFile = open_memstream(&request,&requestLen);
+    char cwd[PATH_MAX];
+    if(getcwd(cwd,sizeof(cwd)) == NULL){
+        cwd[0] = '\0';
+    }
+    fprintf(requestFile,"%s%c",LSD_MAGIC,'\0');
+    fprintf(requestFile,"columns=%d%c",columns,'\0');
+    fprintf(requestFile,"cwd=%s%c",cwd,'\0');
+    for(int i = 1; i < argc; i++){
+        if(strncmp(argv[i],"--connect=",10) == 0){
+            continue;
+        }
+        if(strcmp(argv[i],"--connect") == 0){
+            i++;
+            continue;
+        }
+        if(argv[i][0] == '\0'){
+            continue;
+        }
+        fwrite(argv[i],1,strlen(argv[i])+1,requestFile);
+    }
+    fputc('\0',requestFile);
+    fclose(requestFile);
+
+    struct sockaddr_un address;
+    memset(&address,0,sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path,socketPath,sizeof(address.sun_path)-1);
+    int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(fd == -1 || connect(fd,(struct sockaddr*)&address,sizeof(address)) == -1){
+        fprintf(stderr,"ls: cannot connect to '%s': %s\n",socketPath,strerror(errno));
+        free(request);
+        if(fd != -1){
+            close(fd);
+        }
+        return 2;
+    }
+    unsigned char header[24];
+    if(!writeAll(fd,request,requestLen) || !readAll(fd,(char*)header,sizeof(header)) || memcmp(header,LSD_MAGIC,4) != 0){
+        fprintf(stderr,"ls: bad reply from '%s'\n",socketPath);
+        free(request);
+        close(fd);
+        return 2;
+    }
+    free(request);
+
+    int status = (int)getLE(header+4,4);
+    uint64_t lengths[2] = {getLE(header+8,8), getLE(header+16,8)};
+    FILE* destinations[2] = {stdout, stderr};
+    char buffer[65536];
+    for(int i = 0; i < 2; i++){
+        while(lengths[i] > 0){
+            size_t chunk = lengths[i] < sizeof(buffer) ? lengths[i] : sizeof(buffer);
+            if(!readAll(fd,buffer,chunk)){
+                fprintf(stderr,"ls: reply from '%s' was cut short\n",socketPath);
+                close(fd);
+                return 2;
+            }
+            fwrite(buffer,1,chunk,destinations[i]);
+            lengths[i] -= chunk;
+        }
+    }
+    close(fd);
+    return status;
+}
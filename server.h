@@ -0,0 +1,41 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include "lsscan.h"
+
+/*
+    ls --server PATH keeps one process running, listening on a Unix domain socket, so a caller that
+    lists a lot of directories doesn't pay for process startup and cold caches every time.
+    The uid/gid names, directory reads and formatted timestamps stay cached between requests.
+    Only the user running the server can connect, and --snapshot and --diff are refused, since the
+    server would open those files with its own permissions.
+
+    Request: null terminated strings, ending with an empty string
+        "LSD1"              protocol version
+        "columns=N"         terminal width for the grid
+        "cwd=DIR"           relative targets are looked up from here
+        arguments...        the same arguments the command line takes, without argv[0]
+        ""
+
+    Reply: a 24 byte header, then the output, then the error messages
+        "LSD1"  u32 exit status  u64 output length  u64 error length
+
+    With --binary the output is a stream of records instead of text:
+        folder: 'D' u32 errno  u16 length, path  u64 total blocks  u32 item count, then that many items
+        item:   'E' u16 length, name  u32 mode  u64 size  i64 mtime  u32 mtime nanoseconds  u32 uid  u32 gid
+                u64 hard links  u64 inode  u32 lstat errno  u16 length, owner  u16 length, group  u16 length, link
+        cursor: 'C' u16 length, cursor     after a folder's items, if a --limit page stopped early (see --cursor)
+        end:    'Z'
+    All numbers are little endian. Strings are not null terminated.
+*/
+
+#define LSD_MAGIC "LSD1"
+
+int runServer(const char* socketPath, int threadCount);
+
+int runClient(const char* socketPath, int columns, int argc, char** argv);
+
+void writeRecords(FILE* out, lsRequestedItem* folders, int folderCount, char** targets);
+
+#endif
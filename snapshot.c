@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <linux/limits.h>
+#include "snapshot.h"
+
+//one entry, in the form it is stored in a snapshot
+typedef struct snapshotEntry {
+    char name[NAME_MAX+1];
+    size_t nameLen;
+    uint64_t mode;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t mtimeNsec;
+    uint64_t uid;
+    uint64_t gid;
+    uint64_t nlink;
+    uint64_t ino;
+    char link[PATH_MAX+1];
+    size_t linkLen;
+} snapshotEntry;
+
+static void putVarint(FILE* out, uint64_t value){
+    while(value >= 0x80){
+        putc_unlocked((value & 0x7F) | 0x80,out);
+        value >>= 7;
+    }
+    putc_unlocked(value,out);
+}
+
+static bool getVarint(FILE* in, uint64_t* value){
+    *value = 0;
+    for(int shift = 0; shift < 64; shift += 7){
+        int byte = getc_unlocked(in);
+        if(byte == EOF){
+            return false;
+        }
+        //the last byte only has room for bit 63
+        if(shift == 63 && (byte & 0x7E) != 0){
+            return false;
+        }
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+//reads a varint length and then that many bytes into buffer, which holds up to max bytes plus a null
+static bool getBytes(FILE* in, char* buffer, size_t offset, size_t max, size_t* length){
+    uint64_t count;
+    //count comes from the file, so it is kept from wrapping around offset + count
+    if(!getVarint(in,&count) || offset > max || count > max - offset){
+        return false;
+    }
+    if(fread(buffer+offset,1,count,in) != count){
+        return false;
+    }
+    buffer[offset+count] = '\0';
+    *length = offset + count;
+    return true;
+}
+
+//the numbers a snapshot keeps for an item. They are all 0 if lstat() failed
+static void entryFromItem(const lsItem* item, snapshotEntry* entry){
+    memset(entry,0,offsetof(snapshotEntry,link));
+    entry->link[0] = '\0';
+    entry->linkLen = 0;
+    if(item->lstatSuccessful){
+        entry->mode = item->itemStat.st_mode;
+        entry->size = item->itemStat.st_size;
+        entry->mtime = item->itemStat.st_mtim.tv_sec;
+        entry->mtimeNsec = item->itemStat.st_mtim.tv_nsec;
+        entry->uid = item->itemStat.st_uid;
+        entry->gid = item->itemStat.st_gid;
+        entry->nlink = item->itemStat.st_nlink;
+        entry->ino = item->itemStat.st_ino;
+    }
+    if(item->isLink && item->link != NULL){
+        entry->linkLen = strnlen(item->link,PATH_MAX);
+        memcpy(entry->link,item->link,entry->linkLen);
+        entry->link[entry->linkLen] = '\0';
+    }
+}
+
+/**
+ * @brief Changes options to list in the order snapshots are stored in: by name, whole directories
+ * @param options: Modified by the function. What gets listed is left alone
+ */
+void lsSnapshotOrder(lsOptions* options){
+    options->sortKey = LS_SORT_NAME;
+    options->unsorted = false;
+    options->reverse = false;
+    options->offset = 0;
+    options->limit = 0;
+    options->hasCursor = false;
+}
+
+/**
+ * @brief Writes listings to a snapshot file. See snapshot.h for the format
+ * @param out: The snapshot file
+ * @param folders: Folders filled in by lsListTargets(), with options passed through lsSnapshotOrder()
+ * @param folderCount: Number of folders. Folders that could not be read are left out
+ * @param paths: The path of each folder, used to scan it again when diffing
+ */
+void lsSnapshotWrite(FILE* out, lsRequestedItem* folders, int folderCount, char** paths){
+    fputs(LS_SNAPSHOT_MAGIC,out);
+    for(int i = 0; i < folderCount; i++){
+        if(folders[i].error != 0){
+            continue;
+        }
+        size_t pathLen = strlen(paths[i]);
+        putc_unlocked('D',out);
+        putVarint(out,pathLen);
+        fwrite(paths[i],1,pathLen,out);
+        putVarint(out,folders[i].itemCount);
+        const char* previous = "";
+        for(int j = 0; j < folders[i].itemCount; j++){
+            lsItem* item = &folders[i].items[j];
+            snapshotEntry entry;
+            entryFromItem(item,&entry);
+            //sorted names share a lot of their start with the name before, so only the rest is stored
+            size_t shared = 0;
+            while(previous[shared] != '\0' && previous[shared] == item->name[shared]){
+                shared++;
+            }
+            size_t nameLen = strlen(item->name);
+            putVarint(out,shared);
+            putVarint(out,nameLen - shared);
+            fwrite(item->name+shared,1,nameLen-shared,out);
+            putVarint(out,entry.mode);
+            putVarint(out,entry.size);
+            putVarint(out,((uint64_t)entry.mtime << 1) ^ (uint64_t)(entry.mtime >> 63));
+            putVarint(out,entry.mtimeNsec);
+            putVarint(out,entry.uid);
+            putVarint(out,entry.gid);
+            putVarint(out,entry.nlink);
+            putVarint(out,entry.ino);
+            putVarint(out,entry.linkLen);
+            fwrite(entry.link,1,entry.linkLen,out);
+            previous = item->name;
+        }
+    }
+    putc_unlocked('Z',out);
+}
+
+//reads the next entry of a folder. entry->name has to still hold the previous name
+static bool readEntry(FILE* in, snapshotEntry* entry){
+    uint64_t shared, mtime;
+    if(!getVarint(in,&shared) || shared > entry->nameLen){
+        return false;
+    }
+    if(!getBytes(in,entry->name,shared,NAME_MAX,&entry->nameLen)){
+        return false;
+    }
+    if(!getVarint(in,&entry->mode) || !getVarint(in,&entry->size) || !getVarint(in,&mtime) ||
+        !getVarint(in,&entry->mtimeNsec) || !getVarint(in,&entry->uid) || !getVarint(in,&entry->gid) ||
+        !getVarint(in,&entry->nlink) || !getVarint(in,&entry->ino)){
+        return false;
+    }
+    entry->mtime = (int64_t)(mtime >> 1) ^ -(int64_t)(mtime & 1);
+    return getBytes(in,entry->link,0,PATH_MAX,&entry->linkLen);
+}
+
+//which fields differ between a stored entry and a fresh one
+static unsigned compareEntries(const snapshotEntry* old, const snapshotEntry* new){
+    unsigned changed = 0;
+    if((old->mode & S_IFMT) != (new->mode & S_IFMT)){
+        changed |= LS_CHANGED_TYPE;
+    }
+    else if(old->mode != new->mode){
+        changed |= LS_CHANGED_MODE;
+    }
+    if(old->size != new->size){
+        changed |= LS_CHANGED_SIZE;
+    }
+    if(old->mtime != new->mtime || old->mtimeNsec != new->mtimeNsec){
+        changed |= LS_CHANGED_MTIME;
+    }
+    if(old->uid != new->uid || old->gid != new->gid){
+        changed |= LS_CHANGED_OWNER;
+    }
+    if(old->ino != new->ino){
+        changed |= LS_CHANGED_INODE;
+    }
+    if(old->linkLen != new->linkLen || memcmp(old->link,new->link,old->linkLen) != 0){
+        changed |= LS_CHANGED_LINK;
+    }
+    if(old->nlink != new->nlink){
+        changed |= LS_CHANGED_LINKS;
+    }
+    return changed;
+}
+
+/**
+ * @brief Scans every folder in a snapshot again and reports what changed. Each folder is one merge of two
+ * name sorted lists, so the snapshot is read once from front to back and never held in memory
+ * @param in: The snapshot file
+ * @param options: Which entries to list. Should match what the snapshot was written with.
+ * The order options are ignored, entries are always compared in name order
+ * @param callback: Called for each added, removed or modified entry
+ * @param context: Passed through to the callback
+ * @returns 0, EINVAL if the snapshot is not valid, or ENOMEM
+ */
+int lsSnapshotDiff(FILE* in, const lsOptions* options, lsSnapshotDiffCallback callback, void* context){
+    lsOptions scanOptions = *options;
+    lsSnapshotOrder(&scanOptions);
+
+    char magic[4];
+    if(fread(magic,1,4,in) != 4 || memcmp(magic,LS_SNAPSHOT_MAGIC,4) != 0){
+        return EINVAL;
+    }
+    char path[PATH_MAX+1];
+    snapshotEntry* old = malloc(sizeof(snapshotEntry));
+    snapshotEntry* new = malloc(sizeof(snapshotEntry));
+    if(old == NULL || new == NULL){
+        free(old);
+        free(new);
+        return ENOMEM;
+    }
+    int result = 0;
+    bool stopped = false;
+    int record = 0;
+    while(!stopped && (record = getc_unlocked(in)) == 'D'){
+        size_t pathLen;
+        uint64_t count;
+        if(!getBytes(in,path,0,PATH_MAX,&pathLen) || !getVarint(in,&count)){
+            result = EINVAL;
+            break;
+        }
+        //a folder that can't be read anymore is compared as empty, so everything in it shows up as removed
+        lsRequestedItem folder;
+        lsListDir(path,&scanOptions,&folder);
+        int next = 0;
+        old->nameLen = 0;
+        old->name[0] = '\0';
+        for(uint64_t i = 0; i < count && !stopped; i++){
+            if(!readEntry(in,old)){
+                result = EINVAL;
+                stopped = true;
+                break;
+            }
+            //everything new that sorts before this stored name was added since the snapshot
+            while(next < folder.itemCount && strcmp(folder.items[next].name,old->name) < 0){
+                stopped = callback(LS_ENTRY_ADDED,path,folder.items[next].name,0,context) != 0;
+                next++;
+                if(stopped){
+                    break;
+                }
+            }
+            if(stopped){
+                break;
+            }
+            if(next < folder.itemCount && strcmp(folder.items[next].name,old->name) == 0){
+                entryFromItem(&folder.items[next],new);
+                unsigned changed = compareEntries(old,new);
+                if(changed != 0){
+                    stopped = callback(LS_ENTRY_MODIFIED,path,old->name,changed,context) != 0;
+                }
+                next++;
+            }
+            else {
+                stopped = callback(LS_ENTRY_REMOVED,path,old->name,0,context) != 0;
+            }
+        }
+        for(; !stopped && next < folder.itemCount; next++){
+            stopped = callback(LS_ENTRY_ADDED,path,folder.items[next].name,0,context) != 0;
+        }
+        lsFreeDir(&folder);
+    }
+    if(!stopped && result == 0 && record != 'Z'){
+        result = EINVAL;
+    }
+    free(old);
+    free(new);
+    return result;
+}
@@ -0,0 +1,50 @@
+#ifndef LS_SNAPSHOT_H
+#define LS_SNAPSHOT_H
+
+#include <stdio.h>
+#include "lsscan.h"
+
+/*
+    Snapshots: a listing saved in a compact binary file, so a later scan can be compared with it
+    in one pass instead of diffing text listings.
+
+    File:   "LSS1", then folders, then 'Z'
+    folder: 'D' varint length, path  varint entry count, then the entries sorted by name (strcmp)
+    entry:  varint bytes shared with the previous name  varint length, rest of the name
+            varint mode  varint size  varint mtime (zigzag)  varint mtime nanoseconds  varint uid  varint gid
+            varint hard links  varint inode  varint length, link target
+    A varint is 7 bits per byte, low bits first, with the top bit set on every byte but the last.
+    Entries whose lstat() failed are stored with all their numbers 0.
+*/
+
+#define LS_SNAPSHOT_MAGIC "LSS1"
+
+//what changed about an entry that is in both the snapshot and the new scan
+enum {
+    LS_CHANGED_TYPE = 1 << 0,
+    LS_CHANGED_MODE = 1 << 1,      //permission bits
+    LS_CHANGED_SIZE = 1 << 2,
+    LS_CHANGED_MTIME = 1 << 3,
+    LS_CHANGED_OWNER = 1 << 4,     //uid or gid
+    LS_CHANGED_INODE = 1 << 5,     //the name points to a different file now
+    LS_CHANGED_LINK = 1 << 6,      //where a symbolic link points
+    LS_CHANGED_LINKS = 1 << 7      //hard link count
+};
+
+typedef enum lsSnapshotChange {
+    LS_ENTRY_ADDED = '+',
+    LS_ENTRY_REMOVED = '-',
+    LS_ENTRY_MODIFIED = 'M'
+} lsSnapshotChange;
+
+//called once per difference, in name order within each folder. changed is 0 unless the entry was modified.
+//Returning nonzero stops the diff
+typedef int (*lsSnapshotDiffCallback)(lsSnapshotChange change, const char* dir, const char* name, unsigned changed, void* context);
+
+void lsSnapshotOrder(lsOptions* options);
+
+void lsSnapshotWrite(FILE* out, lsRequestedItem* folders, int folderCount, char** paths);
+
+int lsSnapshotDiff(FILE* in, const lsOptions* options, lsSnapshotDiffCallback callback, void* context);
+
+#endif
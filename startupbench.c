@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <linux/limits.h>
+
+/*
+    Startup benchmark: runs each ls binary given on the command line many times on a small directory,
+    and prints how long one run takes from spawn to exit. For a directory this small nearly all of that
+    is process startup, which is what the fast build is for.
+
+    Usage: startupbench [-n RUNS] LS...
+*/
+
+#define SMALL_DIR_FILES 10
+#define WARMUP_RUNS 50
+
+extern char** environ;
+
+static int compareTimes(const void* a, const void* b){
+    double timeA = *(const double*)a, timeB = *(const double*)b;
+    return (timeA > timeB) - (timeA < timeB);
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1e6 + ts.tv_nsec/1e3;
+}
+
+/**
+ * @brief Runs a binary once, with stdout and stderr going to /dev/null
+ * @returns how long it took in microseconds, or -1 if it could not be run
+ */
+static double timeRun(char** argv, posix_spawn_file_actions_t* actions){
+    double start = now();
+    pid_t pid;
+    if(posix_spawn(&pid,argv[0],actions,NULL,argv,environ) != 0){
+        return -1;
+    }
+    int status;
+    waitpid(pid,&status,0);
+    return now() - start;
+}
+
+/**
+ * @brief Times one command line and prints a summary
+ * @param argv: The command line, argv[0] is the binary
+ * @param runs: How many timed runs
+ * @param actions: Redirects output to /dev/null
+ */
+static void benchmark(char** argv, int runs, posix_spawn_file_actions_t* actions){
+    for(int i = 0; i < WARMUP_RUNS; i++){
+        if(timeRun(argv,actions) < 0){
+            fprintf(stderr,"startupbench: cannot run %s\n",argv[0]);
+            return;
+        }
+    }
+    double* times = malloc(runs*sizeof(double));
+    double total = 0;
+    for(int i = 0; i < runs; i++){
+        times[i] = timeRun(argv,actions);
+        total += times[i];
+    }
+    qsort(times,runs,sizeof(double),compareTimes);
+    printf("%-24s %-4s min %7.1f us  median %7.1f us  mean %7.1f us  p99 %7.1f us\n",argv[0],argv[1][0] == '-' ? argv[1] : "",
+        times[0],times[runs/2],total/runs,times[(int)(runs*0.99)]);
+    free(times);
+}
+
+int main(int argc, char* argv[]){
+    int runs = 2000;
+    int first = 1;
+    if(argc > 2 && strcmp(argv[1],"-n") == 0){
+        runs = atoi(argv[2]);
+        first = 3;
+    }
+    if(first >= argc || runs < 1){
+        fprintf(stderr,"usage: startupbench [-n RUNS] LS...\n");
+        return 2;
+    }
+
+    //the small directory every run lists
+    char dir[] = "/tmp/startupbench.XXXXXX";
+    if(mkdtemp(dir) == NULL){
+        perror("startupbench: mkdtemp");
+        return 1;
+    }
+    char path[PATH_MAX];
+    for(int i = 0; i < SMALL_DIR_FILES; i++){
+        snprintf(path,sizeof(path),"%s/file%d.txt",dir,i);
+        close(open(path,O_CREAT|O_WRONLY,0644));
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions,STDOUT_FILENO,"/dev/null",O_WRONLY,0);
+    posix_spawn_file_actions_addopen(&actions,STDERR_FILENO,"/dev/null",O_WRONLY,0);
+
+    printf("%d runs each, %d files\n",runs,SMALL_DIR_FILES);
+    for(int i = first; i < argc; i++){
+        char* gridArgs[] = {argv[i], dir, NULL};
+        char* longArgs[] = {argv[i], "-l", dir, NULL};
+        benchmark(gridArgs,runs,&actions);
+        benchmark(longArgs,runs,&actions);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+
+    for(int i = 0; i < SMALL_DIR_FILES; i++){
+        snprintf(path,sizeof(path),"%s/file%d.txt",dir,i);
+        unlink(path);
+    }
+    rmdir(dir);
+    return 0;
+}
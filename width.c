@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <string.h>
+#include "width.h"
+
+//inclusive range of code points
+typedef struct codeRange {
+    uint32_t first;
+    uint32_t last;
+} codeRange;
+
+//combining marks and other characters that take up no columns
+static const codeRange zeroWidth[] = {
+    {0x0300,0x036F},{0x0483,0x0489},{0x0591,0x05BD},{0x05BF,0x05BF},{0x05C1,0x05C2},{0x05C4,0x05C5},
+    {0x05C7,0x05C7},{0x0610,0x061A},{0x064B,0x065F},{0x0670,0x0670},{0x06D6,0x06DC},{0x06DF,0x06E4},
+    {0x06E7,0x06E8},{0x06EA,0x06ED},{0x0711,0x0711},{0x0730,0x074A},{0x0901,0x0902},{0x093C,0x093C},
+    {0x0941,0x0948},{0x094D,0x094D},{0x0951,0x0954},{0x0962,0x0963},{0x0E31,0x0E31},{0x0E34,0x0E3A},
+    {0x0E47,0x0E4E},{0x1AB0,0x1AFF},{0x1DC0,0x1DFF},{0x200B,0x200F},{0x202A,0x202E},{0x2060,0x2064},
+    {0x20D0,0x20FF},{0x302A,0x302D},{0x3099,0x309A},{0xFE00,0xFE0F},{0xFE20,0xFE2F},{0xFEFF,0xFEFF},
+    {0x1F3FB,0x1F3FF},{0xE0001,0xE007F},{0xE0100,0xE01EF},
+};
+
+//East Asian wide and fullwidth characters, and emoji that terminals draw two columns wide
+static const codeRange doubleWidth[] = {
+    {0x1100,0x115F},{0x231A,0x231B},{0x2329,0x232A},{0x23E9,0x23EC},{0x23F0,0x23F0},{0x23F3,0x23F3},
+    {0x25FD,0x25FE},{0x2614,0x2615},{0x2648,0x2653},{0x267F,0x267F},{0x2693,0x2693},{0x26A1,0x26A1},
+    {0x26AA,0x26AB},{0x26BD,0x26BE},{0x26C4,0x26C5},{0x26CE,0x26CE},{0x26D4,0x26D4},{0x26EA,0x26EA},
+    {0x26F2,0x26F3},{0x26F5,0x26F5},{0x26FA,0x26FA},{0x26FD,0x26FD},{0x2705,0x2705},{0x270A,0x270B},
+    {0x2728,0x2728},{0x274C,0x274C},{0x274E,0x274E},{0x2753,0x2755},{0x2757,0x2757},{0x2795,0x2797},
+    {0x27B0,0x27B0},{0x27BF,0x27BF},{0x2B1B,0x2B1C},{0x2B50,0x2B50},{0x2B55,0x2B55},{0x2E80,0x303E},
+    {0x3041,0x3247},{0x3250,0x4DBF},{0x4E00,0xA4CF},{0xA960,0xA97F},{0xAC00,0xD7A3},{0xF900,0xFAFF},
+    {0xFE10,0xFE19},{0xFE30,0xFE6F},{0xFF00,0xFF60},{0xFFE0,0xFFE6},{0x16FE0,0x16FE4},{0x17000,0x18CFF},
+    {0x1B000,0x1B2FF},{0x1F004,0x1F004},{0x1F0CF,0x1F0CF},{0x1F18E,0x1F18E},{0x1F191,0x1F19A},{0x1F200,0x1F202},
+    {0x1F210,0x1F23B},{0x1F240,0x1F248},{0x1F250,0x1F251},{0x1F260,0x1F265},{0x1F300,0x1F320},{0x1F32D,0x1F335},
+    {0x1F337,0x1F37C},{0x1F37E,0x1F393},{0x1F3A0,0x1F3CA},{0x1F3CF,0x1F3D3},{0x1F3E0,0x1F3F0},{0x1F3F4,0x1F3F4},
+    {0x1F3F8,0x1F3FA},{0x1F400,0x1F43E},{0x1F440,0x1F440},{0x1F442,0x1F4FC},{0x1F4FF,0x1F53D},{0x1F54B,0x1F54E},
+    {0x1F550,0x1F567},{0x1F57A,0x1F57A},{0x1F595,0x1F596},{0x1F5A4,0x1F5A4},{0x1F5FB,0x1F64F},{0x1F680,0x1F6C5},
+    {0x1F6CC,0x1F6CC},{0x1F6D0,0x1F6D2},{0x1F6D5,0x1F6D7},{0x1F6EB,0x1F6EC},{0x1F6F4,0x1F6FC},{0x1F7E0,0x1F7EB},
+    {0x1F90C,0x1F93A},{0x1F93C,0x1F945},{0x1F947,0x1F9FF},{0x1FA70,0x1FAFF},{0x20000,0x2FFFD},{0x30000,0x3FFFD},
+};
+
+/**
+ * @brief Binary search for a code point in a sorted table of ranges
+ * @param cp: The code point to look for
+ * @param table: Sorted, non-overlapping ranges
+ * @param count: Number of ranges in the table
+ */
+static bool inTable(uint32_t cp, const codeRange* table, size_t count){
+    if(cp < table[0].first || cp > table[count-1].last){
+        return false;
+    }
+    size_t low = 0, high = count;
+    while(low < high){
+        size_t mid = low + (high - low)/2;
+        if(cp > table[mid].last){
+            low = mid + 1;
+        }
+        else if(cp < table[mid].first){
+            high = mid;
+        }
+        else {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Checks if a string is plain ASCII. Looks at 8 bytes per step, so the common case
+ * of an ASCII name is a single pass over the name.
+ * @param str: The string to check. Does not need to be null terminated
+ * @param len: Number of bytes in str
+ */
+bool isAllAscii(const char* str, size_t len){
+    const uint64_t highBits = 0x8080808080808080ULL;
+    uint64_t acc = 0;
+    size_t i = 0;
+    for(; i + 8 <= len; i += 8){
+        uint64_t chunk;
+        memcpy(&chunk,str+i,8);     //memcpy avoids unaligned reads
+        acc |= chunk;
+    }
+    for(; i < len; i++){
+        acc |= (unsigned char)str[i];
+    }
+    return (acc & highBits) == 0;
+}
+
+/**
+ * @brief Decodes one UTF-8 sequence
+ * @param str: Start of the sequence
+ * @param len: Bytes left in the string
+ * @param cp: Set to the decoded code point
+ * @returns number of bytes used, or 0 if the sequence is invalid
+ */
+static size_t decodeUtf8(const unsigned char* str, size_t len, uint32_t* cp){
+    size_t needed;
+    uint32_t value;
+    if(str[0] >= 0xC2 && str[0] <= 0xDF){
+        needed = 2;
+        value = str[0] & 0x1F;
+    }
+    else if(str[0] >= 0xE0 && str[0] <= 0xEF){
+        needed = 3;
+        value = str[0] & 0x0F;
+    }
+    else if(str[0] >= 0xF0 && str[0] <= 0xF4){
+        needed = 4;
+        value = str[0] & 0x07;
+    }
+    else {
+        return 0;
+    }
+    if(needed > len){
+        return 0;
+    }
+    for(size_t i = 1; i < needed; i++){
+        if((str[i] & 0xC0) != 0x80){
+            return 0;
+        }
+        value = (value << 6) | (str[i] & 0x3F);
+    }
+    //reject overlong encodings, surrogates and anything past the unicode range
+    if((needed == 3 && value < 0x800) || (needed == 4 && value < 0x10000) ||
+        (value >= 0xD800 && value <= 0xDFFF) || value > 0x10FFFF){
+        return 0;
+    }
+    *cp = value;
+    return needed;
+}
+
+/**
+ * @brief Gets the number of terminal columns a string takes up when printed.
+ * ASCII strings take one column per byte. Otherwise the string is decoded as UTF-8, where
+ * wide characters take two columns and combining characters take none.
+ * Bytes that are not valid UTF-8 take one column each.
+ * @param str: The string to measure. Does not need to be null terminated
+ * @param len: Number of bytes in str
+ */
+int displayWidth(const char* str, size_t len){
+    if(isAllAscii(str,len)){
+        return (int)len;
+    }
+    const unsigned char* bytes = (const unsigned char*)str;
+    int width = 0;
+    size_t i = 0;
+    while(i < len){
+        if(bytes[i] < 0x80){
+            width++;
+            i++;
+            continue;
+        }
+        uint32_t cp = 0;
+        size_t used = decodeUtf8(bytes+i,len-i,&cp);
+        if(used == 0){
+            //invalid byte, printed as a single replacement character
+            width++;
+            i++;
+            continue;
+        }
+        if(inTable(cp,zeroWidth,sizeof(zeroWidth)/sizeof(zeroWidth[0]))){
+            //no width
+        }
+        else if(inTable(cp,doubleWidth,sizeof(doubleWidth)/sizeof(doubleWidth[0]))){
+            width += 2;
+        }
+        else {
+            width++;
+        }
+        i += used;
+    }
+    return width;
+}
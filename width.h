@@ -0,0 +1,13 @@
+#ifndef WIDTH_H
+#define WIDTH_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+//terminal display width of file names, used for lining up the grid output
+
+bool isAllAscii(const char* str, size_t len);
+
+int displayWidth(const char* str, size_t len);
+
+#endif